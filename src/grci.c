@@ -1,19 +1,48 @@
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE //MAP_ANONYMOUS for the jit
+#endif
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <limits.h>
+#if defined(__x86_64__) && !defined(_WIN32)
+#define GRCI_JIT_X86_64
+#endif
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#define GRCI_FORK_WORKERS
+#endif
 #include "grci.h"
 
 #define GRCI_DEFAULT_CHUNK_SIZE 4096
 #define GRCI_RAM64K_STATE_COUNT 65536 * 8
+#define GRCI_RAM64K_SIZE 65536
+#define GRCI_RAM_PAGE_SIZE 256
+#define GRCI_RAM_PAGE_COUNT (GRCI_RAM64K_SIZE / GRCI_RAM_PAGE_SIZE)
 
 #define GRCI_MAX_PARTS 64
 #define GRCI_MAX_WIRES 32
 #define GRCI_MAX_INPUTS 160
 #define GRCI_MAX_OUTPUTS 128
 #define GRCI_MAX_MODULES 64
+#define GRCI_TRUTH_MAX_INPUTS 28
+#define GRCI_AUTO_MIN_NODES 64
+#define GRCI_AUTO_WARMUP_CYCLES 64
+#define GRCI_AUTO_EVENT_PERCENT 15 //of gates evaluated per step, below which the event driven engine is picked
+#define GRCI_TIMING_MAX_DELAY 1023
+#define GRCI_TIMING_MAX_TIME 65536 //per step, so an oscillating loop can't hang the host
+#define GRCI_SPIN_COUNT 4096 //polls of a shared counter before a worker or the host starts yielding
+#define GRCI_MAX_COUNT (INT_MAX / 2) //for node and scaffolding totals, leaving room for inputs and constants
 
 #define GRCI_OUTPUT_NONE -1
 #define GRCI_OUTPUT_0 -2
@@ -47,7 +76,8 @@ enum grci_err_type {
     GRCI_ERR_COMP = 0,
     GRCI_ERR_SIM,
     GRCI_ERR_MEM,
-    GRCI_ERR_INTERN
+    GRCI_ERR_INTERN,
+    GRCI_ERR_IO
 };
 
 static int grci_err_prefix(enum grci_err_type type, int line) {
@@ -64,6 +94,9 @@ static int grci_err_prefix(enum grci_err_type type, int line) {
     case GRCI_ERR_INTERN:
         sprintf(grci_err_buf, "GRCI internal error: ");
         break;
+    case GRCI_ERR_IO:
+        sprintf(grci_err_buf, "GRCI io error: ");
+        break;
     default:
         sprintf(grci_err_buf, "invalid error code\n");
         break;
@@ -87,8 +120,8 @@ static int grci_err_prefix(enum grci_err_type type, int line) {
         if (strlen(grci_err_buf) == 0) { \
             int off = grci_err_prefix(type, line); \
             sprintf(grci_err_buf + off, fmt, ##__VA_ARGS__); \
-            return NULL; \
         } \
+        return NULL; \
     } while (0)
 
 
@@ -616,10 +649,21 @@ struct grci_module_desc {
     bool is_nand;
     bool is_dff;
     bool is_ram64K;
+    const struct grci_foreign *foreign; //set for modules registered with grci_register_foreign
     int sink_counts[GRCI_MAX_INPUTS]; //cumulative sink counts for each input (eg, including sinks for internal elements that use this input)
 
     int node_count;
     int dff_count;
+    int ram_count;
+    int foreign_count;
+
+    //exact sizes of the instantiation scaffolding for this module and everything below it,
+    //so that grci_make_module can allocate once up front
+    int instance_count;
+    int sink_count;
+    int sink_slot_count;
+    int output_slot_count;
+    int depth;
 };
 
 static void grci_module_desc_init(struct grci_module_desc *decl, struct grci_arena *arena) {
@@ -628,6 +672,9 @@ static void grci_module_desc_init(struct grci_module_desc *decl, struct grci_are
         decl->part_names[i].ptr = NULL;
         decl->part_names[i].len = 0;
     }
+    for (int i = 0; i < GRCI_MAX_OUTPUTS; i++) {
+        decl->outputs[i] = output_part(GRCI_OUTPUT_NONE, GRCI_OUTPUT_NONE);
+    }
     decl->part_count = 0;
     decl->input_count = 0;
     decl->input_param_count = 0;
@@ -636,9 +683,18 @@ static void grci_module_desc_init(struct grci_module_desc *decl, struct grci_are
     decl->is_nand = false;
     decl->is_dff = false;
     decl->is_ram64K = false;
+    decl->foreign = NULL;
 
     decl->node_count = 0;
     decl->dff_count = 0;
+    decl->ram_count = 0;
+    decl->foreign_count = 0;
+
+    decl->instance_count = 0;
+    decl->sink_count = 0;
+    decl->sink_slot_count = 0;
+    decl->output_slot_count = 0;
+    decl->depth = 0;
 }
 
 struct grci_module_desc_list {
@@ -646,6 +702,12 @@ struct grci_module_desc_list {
     int count;
 };
 
+static inline bool grci_count_add(int *total, int add) {
+    if (add > GRCI_MAX_COUNT - *total) return false;
+    *total += add;
+    return true;
+}
+
 static void grci_module_desc_list_init(struct grci_module_desc_list *list) {
     list->count = 0;
 }
@@ -817,6 +879,13 @@ static const struct grci_module_desc *nand_decl(void) {
     //No connections since no parts in nand gate
     nand_data.node_count = 1;
     nand_data.dff_count = 0;
+    nand_data.ram_count = 0;
+
+    nand_data.instance_count = 1;
+    nand_data.sink_count = 2;
+    nand_data.sink_slot_count = 2;
+    nand_data.output_slot_count = 1;
+    nand_data.depth = 1;
 
     return &nand_data;
 }
@@ -838,6 +907,13 @@ static const struct grci_module_desc *dff_decl(void) {
     //No connections since no parts in dff gate
     dff_data.node_count = 1;
     dff_data.dff_count = 1;
+    dff_data.ram_count = 0;
+
+    dff_data.instance_count = 1;
+    dff_data.sink_count = 1;
+    dff_data.sink_slot_count = 1;
+    dff_data.output_slot_count = 1;
+    dff_data.depth = 1;
 
     return &dff_data;
 }
@@ -867,6 +943,13 @@ static const struct grci_module_desc *ram64K_decl(void) {
 
     ram.node_count = 16;
     ram.dff_count = 16;
+    ram.ram_count = 1;
+
+    ram.instance_count = 1;
+    ram.sink_count = 33;
+    ram.sink_slot_count = 33;
+    ram.output_slot_count = 16;
+    ram.depth = 1;
 
     return &ram;
 }
@@ -886,6 +969,51 @@ static void grci_compiler_init(struct grci_compiler *compiler,
     compiler->id_counter = 0;
 }
 
+//A host module is declared like ram64K_decl, with one node per output bit.  Its callbacks and user
+//data are copied, but not the name and width arrays, which are only read here
+static grci_status grci_foreign_decl(struct grci_compiler *compiler, const struct grci_foreign *foreign, struct grci_module_desc *decl) {
+    grci_module_desc_init(decl, &compiler->arena);
+    grci_ensure(foreign->input_param_count >= 0 && foreign->input_param_count <= GRCI_MAX_INPUTS &&
+                foreign->output_param_count > 0 && foreign->output_param_count <= GRCI_MAX_OUTPUTS,
+                GRCI_ERR_COMP, 0, "foreign module %s has too many or too few parameters", foreign->name);
+    grci_ensure(grci_string_alloc(&compiler->arena, foreign->name, strlen(foreign->name), &decl->name), GRCI_ERR_MEM, 0, "placeholder");
+
+    decl->input_param_count = foreign->input_param_count;
+    for (int i = 0; i < foreign->input_param_count; i++) {
+        decl->input_widths[i] = foreign->input_widths[i];
+        decl->input_count += foreign->input_widths[i];
+        grci_ensure(foreign->input_widths[i] > 0 && decl->input_count <= GRCI_MAX_INPUTS, GRCI_ERR_COMP, 0, 
+                    "foreign module %s has bad input widths", foreign->name);
+    }
+    decl->output_param_count = foreign->output_param_count;
+    for (int i = 0; i < foreign->output_param_count; i++) {
+        decl->output_widths[i] = foreign->output_widths[i];
+        decl->output_count += foreign->output_widths[i];
+        grci_ensure(foreign->output_widths[i] > 0 && decl->output_count <= GRCI_MAX_OUTPUTS, GRCI_ERR_COMP, 0, 
+                    "foreign module %s has bad output widths", foreign->name);
+    }
+    for (int i = 0; i < decl->input_count; i++) {
+        decl->sink_counts[i] = 1;
+    }
+
+    struct grci_foreign *copy;
+    grci_ensure(grci_arena_malloc(&compiler->arena, sizeof(struct grci_foreign), (void**) &copy), GRCI_ERR_MEM, 0, "placeholder");
+    *copy = *foreign;
+    copy->name = NULL;
+    copy->input_widths = NULL;
+    copy->output_widths = NULL;
+    decl->foreign = copy;
+
+    decl->node_count = decl->output_count;
+    decl->foreign_count = 1;
+    decl->instance_count = 1;
+    decl->sink_count = decl->input_count;
+    decl->sink_slot_count = decl->input_count;
+    decl->output_slot_count = decl->output_count;
+    decl->depth = 1;
+    return GRCI_OK;
+}
+
 static void grci_compiler_cleanup(struct grci_compiler *compiler) {
     grci_arena_cleanup(&compiler->arena);
 }
@@ -1551,19 +1679,44 @@ static grci_status grci_compiler_compile_module(struct grci_compiler *compiler)
         module_decl.sink_counts[i] = 0;
     }
 
+    //every total can grow exponentially with the depth of the hierarchy
+    bool fits = true;
     for (int part_idx = 0; part_idx < module_decl.part_count; part_idx++) {
         for (int i = 0; i < module_decl.part_connections[part_idx].count; i++) {
             struct grci_connection c = module_decl.part_connections[part_idx].values[i];
             if (c.type == GRCI_IT_EXTERNAL) {
-                module_decl.sink_counts[c.get.parameter_idx] += module_decl.parts[part_idx]->sink_counts[i];
+                fits = fits && grci_count_add(&module_decl.sink_counts[c.get.parameter_idx], module_decl.parts[part_idx]->sink_counts[i]);
             }
         }
     }
 
+    module_decl.instance_count = 1;
+    module_decl.sink_count = module_decl.input_count;
+    module_decl.output_slot_count = module_decl.output_count;
+    for (int i = 0; i < module_decl.input_count; i++) {
+        fits = fits && grci_count_add(&module_decl.sink_slot_count, module_decl.sink_counts[i]);
+    }
+
     for (int part_idx = 0; part_idx < module_decl.part_count; part_idx++) {
-        module_decl.node_count += module_decl.parts[part_idx]->node_count;
-        module_decl.dff_count += module_decl.parts[part_idx]->dff_count;
+        const struct grci_module_desc *part = module_decl.parts[part_idx];
+        fits = fits && grci_count_add(&module_decl.node_count, part->node_count);
+        module_decl.dff_count += part->dff_count;
+        module_decl.ram_count += part->ram_count;
+        module_decl.foreign_count += part->foreign_count;
+
+        fits = fits && grci_count_add(&module_decl.instance_count, part->instance_count) &&
+                       grci_count_add(&module_decl.sink_count, part->sink_count) &&
+                       grci_count_add(&module_decl.sink_slot_count, part->sink_slot_count) &&
+                       grci_count_add(&module_decl.output_slot_count, part->output_slot_count);
+        if (part->depth + 1 > module_decl.depth) {
+            module_decl.depth = part->depth + 1;
+        }
     }
+    //dffs, rams and foreign parts are nodes too, so they can't overflow once the node count fits
+    grci_ensure(fits, GRCI_ERR_COMP, name.line, "Module '%.*s' expands to more than %d nodes or connections",
+                module_decl.name.len, module_decl.name.ptr, GRCI_MAX_COUNT);
+    grci_ensure(compiler->module_defs.count < GRCI_MAX_MODULES, GRCI_ERR_COMP, name.line,
+                "Module '%.*s' exceeds the GRCI_MAX_MODULES of %d", module_decl.name.len, module_decl.name.ptr, GRCI_MAX_MODULES);
 
     grci_module_desc_list_append(&compiler->module_defs, &module_decl);
     compiler->current_module = NULL;
@@ -1580,21 +1733,41 @@ struct grc_input_sink {
     int count;
 };
 
+//Instances only exist while the node graph is being wired.  Their arrays are slices of
+//pools sized exactly by the grci_module_desc totals, see grci_make_module
 struct grci_module_instance {
     const struct grci_module_desc *desc;
-    struct grc_input_sink sinks[GRCI_MAX_INPUTS];
-    struct grci_node *inputs[GRCI_MAX_INPUTS];
-    struct grci_node *outputs[GRCI_MAX_OUTPUTS];
+    struct grc_input_sink *sinks;
+    struct grci_node **outputs;
+    struct grci_module_instance *parts;
+};
 
-    struct grci_submodule submodules[GRCI_MAX_PARTS];
-    int dff_off_len[GRCI_MAX_PARTS][2];
+//Instances (and their sinks) live in a temporary build arena.  This is all that is kept of the
+//top level instance for simulation, sized exactly
+struct grci_module_runtime {
+    const struct grci_module_desc *desc;
+    struct grci_node **inputs;
+    struct grci_node **outputs;
+    struct grci_submodule *submodules;
+    int (*dff_off_len)[2];
 };
 
 enum grci_node_type {
     GRCI_NT_CONSTANT,
     GRCI_NT_NAND,
     GRCI_NT_DFF,
-    GRCI_NT_RAM64KOUT
+    GRCI_NT_RAM64KOUT,
+
+    //only made by grci_fuse_gates, which replaces nand subgraphs with these
+    GRCI_NT_NOT,
+    GRCI_NT_AND,
+    GRCI_NT_OR,
+    GRCI_NT_XOR,
+    GRCI_NT_XNOR,
+    GRCI_NT_MUX,
+
+    //outputs of a module registered with grci_register_foreign
+    GRCI_NT_FOREIGNOUT
 };
 
 struct grci_nand {
@@ -1602,6 +1775,13 @@ struct grci_nand {
     struct grci_node *b;
 };
 
+//a fused gate.  NOT only uses a, and MUX is sel ? b : a
+struct grci_gate {
+    struct grci_node *a;
+    struct grci_node *b;
+    struct grci_node *sel;
+};
+
 struct grci_dff {
     struct grci_node *input;
     bool last_state;
@@ -1613,12 +1793,164 @@ struct grci_ram64k {
     struct grci_node *load;
     struct grci_node *addrs[16];
 
-    char *data;
+    //Memory is split into pages that start out as the shared zero page.  A page is copied the first
+    //time it's written while shared, so untouched memory costs nothing and images can be shared
+    struct grci_ram_page *pages[GRCI_RAM_PAGE_COUNT];
+    struct grci_arena *arena; //pages come from the client allocator, not the arena itself
+    struct grci_journal *journal; //set while byte writes are being journaled
 
     //these should be made
     struct grci_node *outputs[16];
 };
 
+//Instance of a host module.  eval runs when the inputs differ from the last ones it saw, or after a
+//rising edge ran clock, and its outputs are cached in out_values in between
+struct grci_foreign_instance {
+    const struct grci_module_desc *desc;
+    struct grci_node **inputs;
+    struct grci_node **outputs;
+    bool *in_values;
+    bool *out_values;
+    void *state;
+    bool dirty;
+};
+
+struct grci_ram_page {
+    int refs;
+    unsigned char bytes[GRCI_RAM_PAGE_SIZE];
+};
+
+//Undo journal.  Every step is a group of 32 bit words in a ring buffer: a header with the group length,
+//the changes, then the header again so groups can be found from either end.  The top two bits of a
+//change word are its kind.  A ram change is preceded by a word holding (address << 8 | old byte) so
+//that it can be read backwards
+#define GRCI_JOURNAL_DFF 0u    //bit 28 old last_state, bit 29 old cached_state, dff node index below
+#define GRCI_JOURNAL_OUTPUT 1u //bit 28 old value, output index below
+#define GRCI_JOURNAL_RAM 2u    //ram index
+#define GRCI_JOURNAL_GROUP 3u  //number of change words in the group
+#define GRCI_JOURNAL_KIND(w) ((w) >> 30)
+#define GRCI_JOURNAL_INDEX_MASK 0x0fffffffu
+
+struct grci_journal {
+    uint32_t *words;
+    size_t capacity;
+    size_t head; //oldest word
+    size_t count;
+    int groups; //complete groups, ie steps that can be undone
+
+    size_t open; //words in the group of the step in progress, including its header
+    bool overflow; //the step in progress doesn't fit, so the journal is emptied at the end of it
+
+    struct grci_ram64k *rams;
+    bool *before; //dff states and outputs at the start of the step in progress
+};
+
+static void grci_journal_push(struct grci_journal *j, uint32_t word) {
+    if (j->overflow) return;
+    if (j->count == j->capacity) {
+        if (j->groups == 0) {
+            j->overflow = true;
+            return;
+        }
+        size_t len = j->words[j->head] & ~(3u << 30);
+        j->head = (j->head + len + 2) % j->capacity;
+        j->count -= len + 2;
+        j->groups--;
+    }
+    j->words[(j->head + j->count) % j->capacity] = word;
+    j->count++;
+    j->open++;
+}
+
+//never written or freed, so its reference count doesn't matter
+static struct grci_ram_page grci_zero_page;
+
+static inline unsigned char grci_ram_read_byte(const struct grci_ram64k *ram, int addr) {
+    return ram->pages[addr / GRCI_RAM_PAGE_SIZE]->bytes[addr % GRCI_RAM_PAGE_SIZE];
+}
+
+//words are two bytes, low byte first.  Address 0xffff wraps around for the high byte
+static inline int grci_ram_read_word(const struct grci_ram64k *ram, int addr) {
+    return grci_ram_read_byte(ram, addr) | grci_ram_read_byte(ram, (addr + 1) % GRCI_RAM64K_SIZE) << 8;
+}
+
+static void grci_ram_page_release(struct grci_ram64k *ram, struct grci_ram_page *page) {
+    if (page == &grci_zero_page) return;
+    page->refs--;
+    if (page->refs == 0) {
+        ram->arena->free(page);
+    }
+}
+
+//copy on write
+static grci_status grci_ram_own_page(struct grci_ram64k *ram, int page_idx) {
+    struct grci_ram_page *page = ram->pages[page_idx];
+    if (page != &grci_zero_page && page->refs == 1) return GRCI_OK;
+
+    struct grci_ram_page *copy = ram->arena->malloc(sizeof(struct grci_ram_page));
+    grci_ensure(copy, GRCI_ERR_MEM, 0, "malloc failed");
+    copy->refs = 1;
+    memcpy(copy->bytes, page->bytes, GRCI_RAM_PAGE_SIZE);
+    grci_ram_page_release(ram, page);
+    ram->pages[page_idx] = copy;
+    return GRCI_OK;
+}
+
+static inline grci_status grci_ram_write_byte(struct grci_ram64k *ram, int addr, unsigned char value) {
+    unsigned char old = grci_ram_read_byte(ram, addr);
+    if (old == value) return GRCI_OK;
+    if (ram->journal) {
+        grci_journal_push(ram->journal, (uint32_t) addr << 8 | old);
+        grci_journal_push(ram->journal, GRCI_JOURNAL_RAM << 30 | (uint32_t) (ram - ram->journal->rams));
+    }
+    grci_ensure(grci_ram_own_page(ram, addr / GRCI_RAM_PAGE_SIZE), GRCI_ERR_MEM, 0, "placeholder");
+    ram->pages[addr / GRCI_RAM_PAGE_SIZE]->bytes[addr % GRCI_RAM_PAGE_SIZE] = value;
+    return GRCI_OK;
+}
+
+static void grci_ram_read(const struct grci_ram64k *ram, size_t offset, void *data, size_t size) {
+    unsigned char *dst = data;
+    while (size > 0) {
+        size_t page_off = offset % GRCI_RAM_PAGE_SIZE;
+        size_t n = GRCI_RAM_PAGE_SIZE - page_off < size ? GRCI_RAM_PAGE_SIZE - page_off : size;
+        memcpy(dst, ram->pages[offset / GRCI_RAM_PAGE_SIZE]->bytes + page_off, n);
+        dst += n;
+        offset += n;
+        size -= n;
+    }
+}
+
+//pages whose contents don't change are left shared
+static grci_status grci_ram_write(struct grci_ram64k *ram, size_t offset, const void *data, size_t size) {
+    const unsigned char *src = data;
+    while (size > 0) {
+        size_t page_idx = offset / GRCI_RAM_PAGE_SIZE;
+        size_t page_off = offset % GRCI_RAM_PAGE_SIZE;
+        size_t n = GRCI_RAM_PAGE_SIZE - page_off < size ? GRCI_RAM_PAGE_SIZE - page_off : size;
+        if (memcmp(ram->pages[page_idx]->bytes + page_off, src, n) != 0) {
+            if (ram->journal) {
+                for (size_t i = 0; i < n; i++) {
+                    grci_ensure(grci_ram_write_byte(ram, (int) (offset + i), src[i]), GRCI_ERR_MEM, 0, "placeholder");
+                }
+            } else {
+                grci_ensure(grci_ram_own_page(ram, page_idx), GRCI_ERR_MEM, 0, "placeholder");
+                memcpy(ram->pages[page_idx]->bytes + page_off, src, n);
+            }
+        }
+        src += n;
+        offset += n;
+        size -= n;
+    }
+    return GRCI_OK;
+}
+
+static void grci_ram_cleanup(struct grci_ram64k *ram) {
+    for (int i = 0; i < GRCI_RAM_PAGE_COUNT; i++) {
+        grci_ram_page_release(ram, ram->pages[i]);
+        ram->pages[i] = &grci_zero_page;
+    }
+}
+
 struct grci_ram64kOut {
     struct grci_ram64k *ram;
     bool last_state;
@@ -1628,21 +1960,74 @@ struct grci_ram64kOut {
 struct grci_node {
     union {
         struct grci_nand nand;
+        struct grci_gate gate;
         bool constant;
         struct grci_dff dff;
         struct grci_ram64kOut ram64Kout;
+        struct grci_foreign_instance *foreign;
     } as;
     enum grci_node_type type;
     bool visited;
     bool cached_state;
 };
 
+//Combinational inputs of a node, as pointers to the fields holding them so they can also be rewritten.
+//Dffs and ram outputs have none since their inputs are only read on the clock edge
+static inline int grci_node_operands(struct grci_node *node, struct grci_node ***slots) {
+    switch (node->type) {
+    case GRCI_NT_NAND:
+        slots[0] = &node->as.nand.a;
+        slots[1] = &node->as.nand.b;
+        return 2;
+    case GRCI_NT_NOT:
+        slots[0] = &node->as.gate.a;
+        return 1;
+    case GRCI_NT_AND:
+    case GRCI_NT_OR:
+    case GRCI_NT_XOR:
+    case GRCI_NT_XNOR:
+        slots[0] = &node->as.gate.a;
+        slots[1] = &node->as.gate.b;
+        return 2;
+    case GRCI_NT_MUX:
+        slots[0] = &node->as.gate.a;
+        slots[1] = &node->as.gate.b;
+        slots[2] = &node->as.gate.sel;
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+static inline bool grci_gate_value(enum grci_node_type type, bool a, bool b, bool sel) {
+    switch (type) {
+    case GRCI_NT_NOT:  return !a;
+    case GRCI_NT_AND:  return a && b;
+    case GRCI_NT_OR:   return a || b;
+    case GRCI_NT_XOR:  return a != b;
+    case GRCI_NT_XNOR: return a == b;
+    case GRCI_NT_MUX:  return sel ? b : a;
+    default:
+        assert(false);
+        return false;
+    }
+}
+
 
 struct grci_simulator {
     struct grci_arena arena;
 
     struct grci_node *nodes;
     int node_count;
+    int node_capacity;
+
+    struct grci_ram64k *rams;
+    int ram_count;
+    int ram_capacity;
+
+    struct grci_foreign_instance *foreigns;
+    int foreign_count;
+    int foreign_capacity;
 
     //keeping extra list of dff references since they need to be treated
     //a little differently during simulation.  There is (usually)
@@ -1650,12 +2035,31 @@ struct grci_simulator {
     //more quickly if only dffs need to be updated
     struct grci_node **dff_nodes;
     int dff_node_count;
+    int dff_node_capacity;
 
     struct grci_node *const0;
     struct grci_node *const1;
     struct grci_node *clock;
+
+    //set once nodes have been reordered, see grci_reorder_nodes.  node_pos maps an instantiation
+    //order index to the node's current position, or -1 if grci_fuse_gates removed it, and node_orig
+    //is the inverse
+    int *node_pos;
+    int *node_orig;
+    int node_orig_count;
+    bool fused; //set by grci_fuse_gates
+
+
+    //toggle activity statistics.  Only allocated while activity recording is enabled.
+    //Node values are packed 64 to a word so that unchanged nodes can be skipped a word at a time
+    uint64_t *activity_prev;
+    uint64_t *toggle_counts;
+    uint64_t activity_total;
+    uint64_t activity_steps;
 };
 
+static void grci_eval_foreign(struct grci_foreign_instance *f, bool dff_phase);
+
 //this function is only ever called on a high clock signal
 static bool grci_eval_dff(struct grci_node *node, bool root) {
     assert(node && "Node is NULL");
@@ -1679,6 +2083,18 @@ static bool grci_eval_dff(struct grci_node *node, bool root) {
         bool right = grci_eval_dff(node->as.nand.b, false);
         node->cached_state = !(left && right);
         break;
+    case GRCI_NT_NOT:
+    case GRCI_NT_AND:
+    case GRCI_NT_OR:
+    case GRCI_NT_XOR:
+    case GRCI_NT_XNOR:
+    case GRCI_NT_MUX: {
+        bool a = grci_eval_dff(node->as.gate.a, false);
+        bool b = node->type == GRCI_NT_NOT ? a : grci_eval_dff(node->as.gate.b, false);
+        bool sel = node->type == GRCI_NT_MUX && grci_eval_dff(node->as.gate.sel, false);
+        node->cached_state = grci_gate_value(node->type, a, b, sel);
+        break;
+    }
     case GRCI_NT_DFF:
         if (!root) return node->cached_state;
         assert(node->as.dff.input);
@@ -1686,8 +2102,8 @@ static bool grci_eval_dff(struct grci_node *node, bool root) {
         break;
     case GRCI_NT_RAM64KOUT: {
         struct grci_ram64k *ram = node->as.ram64Kout.ram;
-        char input1 = 0;
-        char input2 = 0;
+        unsigned char input1 = 0;
+        unsigned char input2 = 0;
         int addr = 0;
         bool load = grci_eval_dff(ram->load, false);
         for (int i = 0; i < 16; i++) {
@@ -1698,17 +2114,20 @@ static bool grci_eval_dff(struct grci_node *node, bool root) {
             addr  |= grci_eval_dff(ram->addrs[i], false) << i;
         }
         if (load) {
-            ram->data[addr] = input1;
-            ram->data[addr + 1] = input2;
+            //a failed page copy leaves the old value and the error in grci_err
+            grci_ram_write_byte(ram, addr, input1);
+            grci_ram_write_byte(ram, (addr + 1) % GRCI_RAM64K_SIZE, input2);
         }
-        //need 16 bits, so just grabbing an int, which should be at least 16 bits
-        int output = *((int*) &ram->data[addr]);
+        int output = grci_ram_read_word(ram, addr);
         for (int i = 0; i < 16; i++) {
             ram->outputs[i]->visited = true;
             ram->outputs[i]->cached_state = (output >> i) & 1;
         }
         break;
     }
+    case GRCI_NT_FOREIGNOUT:
+        grci_eval_foreign(node->as.foreign, true);
+        break;
     default:
         assert(false);
         break;
@@ -1739,6 +2158,18 @@ static bool grci_eval_node(struct grci_node *node) {
         bool right = grci_eval_node(node->as.nand.b);
         node->cached_state = !(left && right);
         break;
+    case GRCI_NT_NOT:
+    case GRCI_NT_AND:
+    case GRCI_NT_OR:
+    case GRCI_NT_XOR:
+    case GRCI_NT_XNOR:
+    case GRCI_NT_MUX: {
+        bool a = grci_eval_node(node->as.gate.a);
+        bool b = node->type == GRCI_NT_NOT ? a : grci_eval_node(node->as.gate.b);
+        bool sel = node->type == GRCI_NT_MUX && grci_eval_node(node->as.gate.sel);
+        node->cached_state = grci_gate_value(node->type, a, b, sel);
+        break;
+    }
     case GRCI_NT_DFF:
         assert(node->as.dff.input);
         break;
@@ -1748,13 +2179,16 @@ static bool grci_eval_node(struct grci_node *node) {
         for (int i = 0; i < 16; i++) {
             addr  |= grci_eval_dff(ram->addrs[i], false) << i;
         }
-        int output = *((int*) &ram->data[addr]);
+        int output = grci_ram_read_word(ram, addr);
         for (int i = 0; i < 16; i++) {
             ram->outputs[i]->visited = true;
             ram->outputs[i]->cached_state = (output >> i) & 1;
         }
         break;
     }
+    case GRCI_NT_FOREIGNOUT:
+        grci_eval_foreign(node->as.foreign, false);
+        break;
     default:
         assert(false);
         break;
@@ -1763,11 +2197,45 @@ static bool grci_eval_node(struct grci_node *node) {
     return node->cached_state;
 }
 
-struct grci_node *grci_constant_new(struct grci_simulator *sim, bool c) {
+//evaluates the inputs with the evaluator of the current phase, and eval only if something changed
+static void grci_eval_foreign(struct grci_foreign_instance *f, bool dff_phase) {
+    //marked first so a loop back through the outputs sees the previous values instead of recursing
+    for (int i = 0; i < f->desc->output_count; i++) {
+        f->outputs[i]->visited = true;
+    }
+    bool changed = f->dirty;
+    for (int i = 0; i < f->desc->input_count; i++) {
+        bool v = dff_phase ? grci_eval_dff(f->inputs[i], false) : grci_eval_node(f->inputs[i]);
+        changed = changed || v != f->in_values[i];
+        f->in_values[i] = v;
+    }
+    if (changed && f->desc->foreign->eval) {
+        f->desc->foreign->eval(f->state, f->in_values, f->out_values, f->desc->foreign->user);
+    }
+    f->dirty = false;
+    for (int i = 0; i < f->desc->output_count; i++) {
+        f->outputs[i]->cached_state = f->out_values[i];
+    }
+}
+
+static inline struct grci_node *grci_node_new(struct grci_simulator *sim, enum grci_node_type type) {
+    assert(sim->node_count < sim->node_capacity);
     struct grci_node *n = &sim->nodes[sim->node_count];
     sim->node_count++;
-    n->type = GRCI_NT_CONSTANT;
+    n->type = type;
     n->visited = false;
+    n->cached_state = false;
+    return n;
+}
+
+static inline void grci_dff_list_append(struct grci_simulator *sim, struct grci_node *n) {
+    assert(sim->dff_node_count < sim->dff_node_capacity);
+    sim->dff_nodes[sim->dff_node_count] = n;
+    sim->dff_node_count++;
+}
+
+struct grci_node *grci_constant_new(struct grci_simulator *sim, bool c) {
+    struct grci_node *n = grci_node_new(sim, GRCI_NT_CONSTANT);
     n->cached_state = c;
 
     n->as.constant = c;
@@ -1775,11 +2243,7 @@ struct grci_node *grci_constant_new(struct grci_simulator *sim, bool c) {
 }
 
 struct grci_node *grci_nand_new(struct grci_simulator *sim, struct grci_node *a, struct grci_node *b) {
-    struct grci_node *n = &sim->nodes[sim->node_count];
-    sim->node_count++;
-    n->type = GRCI_NT_NAND;
-    n->visited = false;
-    n->cached_state = false;
+    struct grci_node *n = grci_node_new(sim, GRCI_NT_NAND);
 
     n->as.nand.a = a;
     n->as.nand.b = b;
@@ -1788,51 +2252,60 @@ struct grci_node *grci_nand_new(struct grci_simulator *sim, struct grci_node *a,
 
 
 struct grci_node *grci_dff_new(struct grci_simulator *sim) {
-    struct grci_node *n = &sim->nodes[sim->node_count];
-    sim->node_count++;
-    n->type = GRCI_NT_DFF;
-    n->visited = false;
-    n->cached_state = false;
+    struct grci_node *n = grci_node_new(sim, GRCI_NT_DFF);
 
     n->as.dff.last_state = false;
 
-    sim->dff_nodes[sim->dff_node_count] = n;
-    sim->dff_node_count++;
+    grci_dff_list_append(sim, n);
 
     return n;
 }
 
 struct grci_node *grci_ram64kout_new(struct grci_simulator *sim, struct grci_ram64k *ram) {
-    struct grci_node *n = &sim->nodes[sim->node_count];
-    sim->node_count++;
-    n->type = GRCI_NT_RAM64KOUT;
-    n->visited = false;
-    n->cached_state = false;
+    struct grci_node *n = grci_node_new(sim, GRCI_NT_RAM64KOUT);
 
     n->as.ram64Kout.ram = ram;
     n->as.ram64Kout.last_state = false;
 
-    sim->dff_nodes[sim->dff_node_count] = n;
-    sim->dff_node_count++;
+    grci_dff_list_append(sim, n);
 
     return n;
 }
 
-
+//rams and their data are preallocated in grci_simulator_alloc
 struct grci_ram64k *grci_ram64k_new(struct grci_simulator *sim) {
-    struct grci_ram64k *ram;
-    grci_ensure_retnull(grci_arena_malloc(&sim->arena, sizeof(struct grci_ram64k), (void **) &ram),
-                        GRCI_ERR_MEM, 0, "placeholder");
+    assert(sim->ram_count < sim->ram_capacity);
+    struct grci_ram64k *ram = &sim->rams[sim->ram_count];
+    sim->ram_count++;
 
     for (int i = 0; i < 16; i++) {
         ram->outputs[i] = grci_ram64kout_new(sim, ram);
     }
 
-    grci_ensure_retnull(grci_arena_malloc(&sim->arena, 65536, (void**) &ram->data),
-                        GRCI_ERR_MEM, 0, "placeholder");
     return ram;
 }
 
+struct grci_foreign_instance *grci_foreign_new(struct grci_simulator *sim, const struct grci_module_desc *desc) {
+    assert(sim->foreign_count < sim->foreign_capacity);
+    struct grci_foreign_instance *f = &sim->foreigns[sim->foreign_count];
+    sim->foreign_count++;
+
+    f->desc = desc;
+    f->dirty = true;
+    bool ok = grci_arena_calloc(&sim->arena, desc->input_count + 1, sizeof(struct grci_node*), (void**) &f->inputs) &&
+              grci_arena_calloc(&sim->arena, desc->output_count, sizeof(struct grci_node*), (void**) &f->outputs) &&
+              grci_arena_calloc(&sim->arena, desc->input_count + 1, sizeof(bool), (void**) &f->in_values) &&
+              grci_arena_calloc(&sim->arena, desc->output_count, sizeof(bool), (void**) &f->out_values) &&
+              grci_arena_calloc(&sim->arena, desc->foreign->state_size + 1, 1, (void**) &f->state);
+    grci_ensure_retnull(ok, GRCI_ERR_MEM, 0, "placeholder");
+
+    for (int i = 0; i < desc->output_count; i++) {
+        f->outputs[i] = grci_node_new(sim, GRCI_NT_FOREIGNOUT);
+        f->outputs[i]->as.foreign = f;
+    }
+    return f;
+}
+
 struct grci_input_data {
     enum grci_input_type type;
     union {
@@ -1841,71 +2314,60 @@ struct grci_input_data {
     } as;
 };
 
-struct grci_input_list {
-    struct grci_input_data *values;
-    int capacity;
-    int count;
-};
-
-static grci_status grci_input_list_init(struct grci_arena *arena, struct grci_input_list *l, int capacity) {
-    l->capacity = capacity;
-    grci_ensure(grci_arena_malloc(arena, sizeof(struct grci_input_data) * capacity, (void **) &l->values),
-                GRCI_ERR_MEM, 0, "placeholder");
-    l->count = 0;
-    return GRCI_OK;
+static void grci_connect_input(struct grci_module_instance *api, int input_idx, const struct grci_input_data *input) {
+    struct grc_input_sink *sink = &api->sinks[input_idx];
+    for (int j = 0; j < api->desc->sink_counts[input_idx]; j++) {
+        switch (input->type) {
+        case GRCI_IT_INTERNAL:
+            *(sink->ptps[j]) = input->as.obj;
+            break;
+        case GRCI_IT_EXTERNAL:
+            input->as.sink->ptps[input->as.sink->count] = sink->ptps[j];
+            input->as.sink->count++;
+            break;
+        case GRCI_IT_CONSTANT:
+        case GRCI_IT_CLOCK:
+            *(sink->ptps[j]) = input->as.obj;
+            break;
+        default:
+            assert(false && "Unknown input type");
+        }
+    }
 }
 
-static void grci_input_list_append(struct grci_input_list *l, struct grci_input_data pc) {
-    assert(l->count < l->capacity);
+struct grci_instance_pools {
+    struct grci_module_instance *instances;
+    struct grc_input_sink *sinks;
+    struct grci_node ***sink_slots;
+    struct grci_node **outputs;
+};
 
-    l->values[l->count] = pc;
-    l->count++;
-}
+//hands out this instance's slices of the preallocated pools
+static void grci_instance_enter(struct grci_instance_pools *pools, struct grci_module_instance *api) {
+    const struct grci_module_desc *desc = api->desc;
 
-static void grci_set_module_inputs(struct grci_module_instance *api, const struct grci_input_data *inputs) {
-    for (int i = 0; i < api->desc->input_count; i++) {
-        const struct grci_input_data *input = &inputs[i];
-        for (int j = 0; j < api->desc->sink_counts[i]; j++) {
-            switch (input->type) {
-            case GRCI_IT_INTERNAL:
-                *(api->sinks[i].ptps[j]) = input->as.obj;
-                break;
-            case GRCI_IT_EXTERNAL:
-                input->as.sink->ptps[input->as.sink->count] = api->sinks[i].ptps[j];
-                input->as.sink->count++;
-                break;
-            case GRCI_IT_CONSTANT:
-            case GRCI_IT_CLOCK:
-                *(api->sinks[i].ptps[j]) = input->as.obj;
-                break;
-            default:
-                assert(false && "Unknown input type");
-            }
-        }
+    api->sinks = pools->sinks;
+    pools->sinks += desc->input_count;
+    for (int i = 0; i < desc->input_count; i++) {
+        api->sinks[i].ptps = pools->sink_slots;
+        api->sinks[i].count = 0;
+        pools->sink_slots += desc->sink_counts[i];
     }
-}
 
-static grci_status grci_make_module(struct grci_simulator *sim, struct grci_module_instance *api) {
-    const struct grci_module_desc *data = api->desc;
+    api->outputs = pools->outputs;
+    pools->outputs += desc->output_count;
 
-    
-    struct grci_module_instance *apis;
-    grci_ensure(grci_arena_malloc(&sim->arena, sizeof(struct grci_module_instance) * data->part_count, (void **)&apis), 
-                GRCI_ERR_MEM, 0, "placeholder");
-    assert(apis);
-    for (int i = 0; i < data->part_count; i++) {
-        api->dff_off_len[i][0] = sim->dff_node_count;
-        apis[i].desc = api->desc->parts[i];
-        grci_make_module(sim, &apis[i]);
-        api->dff_off_len[i][1] = sim->dff_node_count - api->dff_off_len[i][0];
+    api->parts = pools->instances;
+    pools->instances += desc->part_count;
+    for (int i = 0; i < desc->part_count; i++) {
+        api->parts[i].desc = desc->parts[i];
     }
+}
 
-    for (int i = 0; i < data->input_count; i++) {
-        int sink_count = api->desc->sink_counts[i];
-        grci_ensure(grci_arena_malloc(&sim->arena, sizeof(struct grci_node**) * sink_count, (void**) &api->sinks[i].ptps), 
-                    GRCI_ERR_MEM, 0, "placeholder");
-        api->sinks[i].count = 0;
-    }
+//called once all parts of an instance have been made
+static grci_status grci_instance_finish(struct grci_simulator *sim, struct grci_module_instance *api) {
+    const struct grci_module_desc *data = api->desc;
+    struct grci_module_instance *apis = api->parts;
 
     //built-in modules
     if (data->is_nand) {
@@ -1917,7 +2379,6 @@ static grci_status grci_make_module(struct grci_simulator *sim, struct grci_modu
 
         //nand connects to output
         api->outputs[0] = node;
-
         return GRCI_OK;
     } else if (data->is_dff) {
         struct grci_node *node = grci_dff_new(sim);
@@ -1941,16 +2402,20 @@ static grci_status grci_make_module(struct grci_simulator *sim, struct grci_modu
         for (int i = 0; i < 16; i++) {
             api->outputs[i] = ram->outputs[i]; 
         }
-
+        return GRCI_OK;
+    } else if (data->foreign) {
+        struct grci_foreign_instance *f = grci_foreign_new(sim, data);
+        grci_ensure(f, GRCI_ERR_MEM, 0, "placeholder");
+        for (int i = 0; i < data->input_count; i++) {
+            api->sinks[i].ptps[0] = &f->inputs[i];
+        }
+        memcpy(api->outputs, f->outputs, sizeof(struct grci_node*) * data->output_count);
         return GRCI_OK;
     }
 
 
     //Set inputs for internal elements.  Module inputs are set during module instantiation
     for (int part_idx = 0; part_idx < data->part_count; part_idx++) {
-        struct grci_input_list inputs;
-        grci_ensure(grci_input_list_init(&sim->arena, &inputs, data->part_connections[part_idx].count),
-                    GRCI_ERR_MEM, 0, "placeholder");
         for (int i = 0; i < data->part_connections[part_idx].count; i++) {
             struct grci_connection c = data->part_connections[part_idx].values[i];
             struct grci_input_data input;
@@ -1973,17 +2438,16 @@ static grci_status grci_make_module(struct grci_simulator *sim, struct grci_modu
                 break;
             default:
                 assert(false && "Uknown input type");
-                break;
+                continue;
             }
-            grci_input_list_append(&inputs, input);
+            grci_connect_input(&apis[part_idx], i, &input);
         }
-
-        grci_set_module_inputs(&apis[part_idx], inputs.values);
     }
 
     for (int i = 0; i < data->output_count; i++) {
         const struct grci_element *part = &data->outputs[i];
         switch (part->idx) {
+        case GRCI_OUTPUT_NONE: //output never connected (compiler doesn't report this yet), so it reads as 0
         case GRCI_OUTPUT_0:
             api->outputs[i] = sim->const0;
             break;
@@ -1995,34 +2459,264 @@ static grci_status grci_make_module(struct grci_simulator *sim, struct grci_modu
             break;
         }
     }
-
     return GRCI_OK;
 }
 
+struct grci_make_frame {
+    struct grci_module_instance *api;
+    int next_part;
+};
+
+//Two passes: the compiler already summed exact scaffolding sizes into the description, so every pool
+//is allocated once here.  The hierarchy is then walked depth first with an explicit stack, making
+//parts before the instance that wires them together.  Nodes end up in the same order the recursive
+//walk produced, so each part still occupies a contiguous node range.
+//The dff range of each top level part is written to dff_off_len.
+static grci_status grci_make_module(struct grci_simulator *sim, struct grci_arena *build, struct grci_module_instance *top, int (*dff_off_len)[2]) {
+    const struct grci_module_desc *desc = top->desc;
+
+    struct grci_instance_pools pools;
+    struct grci_make_frame *stack;
+    grci_ensure(grci_arena_malloc(build, sizeof(struct grci_module_instance) * desc->instance_count, (void**) &pools.instances),
+                GRCI_ERR_MEM, 0, "placeholder");
+    grci_ensure(grci_arena_malloc(build, sizeof(struct grc_input_sink) * desc->sink_count, (void**) &pools.sinks),
+                GRCI_ERR_MEM, 0, "placeholder");
+    grci_ensure(grci_arena_malloc(build, sizeof(struct grci_node**) * desc->sink_slot_count, (void**) &pools.sink_slots),
+                GRCI_ERR_MEM, 0, "placeholder");
+    grci_ensure(grci_arena_malloc(build, sizeof(struct grci_node*) * desc->output_slot_count, (void**) &pools.outputs),
+                GRCI_ERR_MEM, 0, "placeholder");
+    grci_ensure(grci_arena_malloc(build, sizeof(struct grci_make_frame) * desc->depth, (void**) &stack),
+                GRCI_ERR_MEM, 0, "placeholder");
+
+    pools.instances++; //top level instance is owned by the caller
+    grci_instance_enter(&pools, top);
+    stack[0] = (struct grci_make_frame) { .api=top, .next_part=0 };
+    int count = 1;
 
-static void grci_simulator_init(struct grci_simulator *sim, 
-                                void* (*malloc)(size_t), 
-                                void* (*realloc)(void*, size_t), 
-                                void (*free)(void*), 
-                                int node_count, 
-                                int dff_count) {
+    while (count > 0) {
+        struct grci_make_frame *frame = &stack[count - 1];
+        struct grci_module_instance *api = frame->api;
 
-    node_count += 3; //for const0, const1, and clock
-    grci_arena_init(&sim->arena, malloc, realloc, free);
+        if (frame->next_part < api->desc->part_count) {
+            if (count == 1) {
+                dff_off_len[frame->next_part][0] = sim->dff_node_count;
+            }
+            struct grci_module_instance *part = &api->parts[frame->next_part];
+            frame->next_part++;
+
+            assert(count < desc->depth);
+            grci_instance_enter(&pools, part);
+            stack[count] = (struct grci_make_frame) { .api=part, .next_part=0 };
+            count++;
+        } else {
+            grci_ensure(grci_instance_finish(sim, api), GRCI_ERR_MEM, 0, "placeholder");
+            count--;
+
+            if (count == 1) {
+                int part_idx = stack[0].next_part - 1;
+                dff_off_len[part_idx][1] = sim->dff_node_count - dff_off_len[part_idx][0];
+            }
+        }
+    }
+
+    return GRCI_OK;
+}
+
+
+//allocates node, dff and ram storage without creating any nodes
+static grci_status grci_simulator_alloc(struct grci_simulator *sim, 
+                                        void* (*malloc)(size_t), 
+                                        void* (*realloc)(void*, size_t), 
+                                        void (*free)(void*), 
+                                        int node_count, 
+                                        int dff_count,
+                                        int ram_count) {
+    grci_ensure(grci_arena_init(&sim->arena, malloc, realloc, free), GRCI_ERR_MEM, 0, "placeholder");
     sim->nodes = malloc(sizeof(struct grci_node) * node_count);
     sim->node_count = 0;
-    sim->dff_nodes = malloc(sizeof(struct grci_node*) * dff_count);
+    sim->node_capacity = node_count;
+    sim->dff_nodes = malloc(sizeof(struct grci_node*) * (dff_count > 0 ? dff_count : 1));
     sim->dff_node_count = 0;
+    sim->dff_node_capacity = dff_count;
+    sim->node_pos = NULL;
+    sim->node_orig = NULL;
+    sim->fused = false;
+    sim->activity_prev = NULL;
+    sim->toggle_counts = NULL;
+    sim->foreigns = NULL;
+    sim->foreign_count = 0;
+    sim->foreign_capacity = 0;
+    grci_ensure(sim->nodes && sim->dff_nodes, GRCI_ERR_MEM, 0, "malloc failed");
+
+    sim->ram_count = 0;
+    sim->ram_capacity = ram_count;
+    grci_ensure(grci_arena_calloc(&sim->arena, ram_count, sizeof(struct grci_ram64k), (void**) &sim->rams),
+                GRCI_ERR_MEM, 0, "placeholder");
+    for (int i = 0; i < ram_count; i++) {
+        sim->rams[i].arena = &sim->arena;
+        for (int j = 0; j < GRCI_RAM_PAGE_COUNT; j++) {
+            sim->rams[i].pages[j] = &grci_zero_page;
+        }
+    }
+
+    return GRCI_OK;
+}
+
+static grci_status grci_simulator_init(struct grci_simulator *sim, 
+                                       void* (*malloc)(size_t), 
+                                       void* (*realloc)(void*, size_t), 
+                                       void (*free)(void*), 
+                                       int node_count, 
+                                       int dff_count,
+                                       int ram_count) {
+
+    node_count += 3; //for const0, const1, and clock
+    grci_ensure(grci_simulator_alloc(sim, malloc, realloc, free, node_count, dff_count, ram_count),
+                GRCI_ERR_MEM, 0, "placeholder");
 
     sim->const0 = grci_constant_new(sim, 0);
     sim->const1 = grci_constant_new(sim, 1);
     sim->clock = grci_constant_new(sim, 1); //clock signal is changed first in grci_step_module, so this allows first step to be on low clock signal
+
+    return GRCI_OK;
 }
 
 static void grci_simulator_cleanup(struct grci_simulator *sim) {
+    if (sim->toggle_counts) {
+        sim->arena.free(sim->activity_prev);
+        sim->arena.free(sim->toggle_counts);
+    }
+    for (int i = 0; i < sim->ram_count; i++) {
+        grci_ram_cleanup(&sim->rams[i]);
+    }
     grci_arena_cleanup(&sim->arena);
-    free(sim->nodes);
-    free(sim->dff_nodes);
+    sim->arena.free(sim->nodes);
+    sim->arena.free(sim->dff_nodes);
+}
+
+static inline int grci_ctz64(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    int n = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+static inline int grci_popcount64(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    int n = 0;
+    while (x) {
+        x &= x - 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+//current position of the node at index idx in instantiation order
+static inline int grci_node_pos(const struct grci_simulator *sim, int idx) {
+    return sim->node_pos ? sim->node_pos[idx] : idx;
+}
+
+static inline int grci_activity_word_count(const struct grci_simulator *sim) {
+    return (sim->node_count + 63) / 64;
+}
+
+static inline uint64_t grci_pack_node_word(const struct grci_simulator *sim, int word) {
+    uint64_t packed = 0;
+    int end = (word + 1) * 64 < sim->node_count ? (word + 1) * 64 : sim->node_count;
+    for (int i = word * 64; i < end; i++) {
+        packed |= (uint64_t) sim->nodes[i].cached_state << (i - word * 64);
+    }
+    return packed;
+}
+
+static grci_status grci_activity_enable(struct grci_simulator *sim) {
+    if (sim->toggle_counts) return GRCI_OK;
+
+    int words = grci_activity_word_count(sim);
+    sim->activity_prev = sim->arena.malloc(sizeof(uint64_t) * words);
+    sim->toggle_counts = sim->arena.malloc(sizeof(uint64_t) * sim->node_count);
+    grci_ensure(sim->activity_prev && sim->toggle_counts, GRCI_ERR_MEM, 0, "malloc failed");
+
+    for (int w = 0; w < words; w++) {
+        sim->activity_prev[w] = grci_pack_node_word(sim, w);
+    }
+    memset(sim->toggle_counts, 0, sizeof(uint64_t) * sim->node_count);
+    sim->activity_total = 0;
+    sim->activity_steps = 0;
+
+    return GRCI_OK;
+}
+
+static void grci_activity_disable(struct grci_simulator *sim) {
+    if (!sim->toggle_counts) return;
+
+    sim->arena.free(sim->activity_prev);
+    sim->arena.free(sim->toggle_counts);
+    sim->activity_prev = NULL;
+    sim->toggle_counts = NULL;
+}
+
+//XOR the packed node values against the previous step and only visit the bits that changed.  Packing
+//itself still reads every node's cached_state each step, since nodes don't keep a packed copy up to date
+static void grci_activity_record(struct grci_simulator *sim) {
+    int words = grci_activity_word_count(sim);
+    for (int w = 0; w < words; w++) {
+        uint64_t cur = grci_pack_node_word(sim, w);
+        uint64_t diff = cur ^ sim->activity_prev[w];
+        sim->activity_prev[w] = cur;
+        sim->activity_total += grci_popcount64(diff);
+        while (diff) {
+            sim->toggle_counts[w * 64 + grci_ctz64(diff)]++;
+            diff &= diff - 1;
+        }
+    }
+    sim->activity_steps++;
+}
+
+//Parts are instantiated depth first, so every part occupies a contiguous range of desc->node_count nodes.
+//The top level module starts after const0, const1 and clock.  Nested parts are addressed with
+//a dotted path of part names, eg "cpu.alu".  If part isn't NULL it is set to the part's description
+static grci_status grci_part_node_range(const struct grci_module_desc *desc, const char *path, size_t len, int *off, int *count, 
+                                        const struct grci_module_desc **part) {
+    int base = 3;
+    size_t start = 0;
+    while (start < len) {
+        size_t end = start;
+        while (end < len && path[end] != '.') {
+            end++;
+        }
+
+        int part_idx = -1;
+        int part_off = 0;
+        for (int i = 0; i < desc->part_count; i++) {
+            if (desc->part_names[i].ptr && grci_string_matches(&desc->part_names[i], path + start, end - start)) {
+                part_idx = i;
+                break;
+            }
+            part_off += desc->parts[i]->node_count;
+        }
+        grci_ensure(part_idx != -1, GRCI_ERR_SIM, 0, "submodule %.*s does not exist", (int) len, path);
+
+        base += part_off;
+        desc = desc->parts[part_idx];
+        start = end + 1;
+    }
+
+    *off = base;
+    *count = desc->node_count;
+    if (part) {
+        *part = desc;
+    }
+    return GRCI_OK;
 }
 
 static void grci_module_desc_print(const struct grci_module_desc *m) {
@@ -2075,22 +2769,97 @@ struct grci {
     void* (*client_realloc)(void*, size_t);
     void (*client_free)(void*);
     struct grci_compiler compiler;
+
+    //destroyed instances kept for reuse, one free list per compiled module, see grci_set_pool
+    struct grci_module *pool[GRCI_MAX_MODULES];
+    int pool_counts[GRCI_MAX_MODULES];
+    int pool_limit;
+
+    struct grci_limits limits; //see grci_set_limits
 };
 
-struct grci_sim {
-    struct grci_simulator sim;
-    struct grci_module_instance module;
-    struct grci *g;
+struct grci_checkpoint {
+    uint64_t step;
+    unsigned char *bits; //clock, then last and cached state of every dff node, then the module outputs
+    struct grci_ram_page **pages; //GRCI_RAM_PAGE_COUNT references per ram
+    size_t size;
 };
 
-struct grci* grci_init(void* (*malloc)(size_t), void* (*realloc)(void*, size_t), void (*free)(void*)) {
-    struct grci *g = malloc(sizeof(struct grci));
-    grci_ensure_retnull(g, GRCI_ERR_MEM, 0, "malloc failed");
+//Checkpoints are taken every interval steps, and inputs are recorded for every step so that any step
+//since the oldest kept checkpoint can be reached by restoring a checkpoint and replaying from it
+struct grci_checkpoints {
+    int interval;
+    size_t budget;
+    size_t used; //checkpoints and the input history
+
+    struct grci_checkpoint *entries;
+    int count;
+    int capacity;
+
+    unsigned char *inputs; //packed module inputs, input_bytes per step from input_base
+    int input_bytes;
+    uint64_t input_base; //step of the oldest checkpoint
+    uint64_t input_capacity; //in steps
+
+    bool host_write; //ram contents changed outside of stepping
+};
+
+struct grci_link {
+    struct grci_module *src;
+    int src_output;
+    int dst_input;
+    int width;
+};
+
+struct grci_sim {
+    struct grci_simulator sim;
+    struct grci_module_runtime module;
+    struct grci *g;
+
+    uint64_t step_count;
+    struct grci_checkpoints checkpoints;
+    struct grci_journal journal;
+    struct grci_jit *jit;
+    struct grci_timing_sim *timing;
+
+    struct grci_capture *capture; //owned by the host, see grci_set_capture
+    int *capture_parts; //part index of each captured submodule
+
+    struct grci_checkpoint power_on; //what grci_reset_module restores, if bits is set
+    struct grci_module *pool_next;
+    uint64_t step_limit; //0 for none, see grci_set_limits
+    char engine_reason[160]; //see grci_get_engine
+
+    //inputs driven by other modules' outputs, the modules linked to this one either way, and the order
+    //grci_step_linked steps the whole linked group in
+    struct grci_link *links;
+    int link_count;
+    struct grci_module **peers;
+    int peer_count;
+    struct grci_module **link_order;
+    int link_order_count;
+};
+
+static grci_status grci_module_runtime_init(struct grci_module_runtime *rt, struct grci_arena *arena, int input_count, int output_count, int part_count) {
+    grci_ensure(grci_arena_calloc(arena, input_count, sizeof(struct grci_node*), (void**) &rt->inputs), GRCI_ERR_MEM, 0, "placeholder");
+    grci_ensure(grci_arena_calloc(arena, output_count, sizeof(struct grci_node*), (void**) &rt->outputs), GRCI_ERR_MEM, 0, "placeholder");
+    grci_ensure(grci_arena_calloc(arena, part_count, sizeof(struct grci_submodule), (void**) &rt->submodules), GRCI_ERR_MEM, 0, "placeholder");
+    grci_ensure(grci_arena_calloc(arena, part_count, sizeof(int[2]), (void**) &rt->dff_off_len), GRCI_ERR_MEM, 0, "placeholder");
+    return GRCI_OK;
+}
+
+struct grci* grci_init(void* (*malloc)(size_t), void* (*realloc)(void*, size_t), void (*free)(void*)) {
+    struct grci *g = malloc(sizeof(struct grci));
+    grci_ensure_retnull(g, GRCI_ERR_MEM, 0, "malloc failed");
 
     g->client_malloc = malloc;
     g->client_realloc = realloc;
     g->client_free = free;
     grci_compiler_init(&g->compiler, malloc, realloc, free);
+    memset(g->pool, 0, sizeof(g->pool));
+    memset(g->pool_counts, 0, sizeof(g->pool_counts));
+    g->pool_limit = 0;
+    memset(&g->limits, 0, sizeof(g->limits));
 
     grci_err_buf[0] = '\0';
 
@@ -2126,35 +2895,202 @@ grci_status grci_compile_src(struct grci *g, const char *buf, size_t len) {
     return GRCI_OK;
 }
 
-struct grci_module *grci_init_module(struct grci *g, const char *module_name, size_t len) {
-    struct grci_module *module = g->client_malloc(sizeof(struct grci_module));
+//Makes a host implemented module usable as a part by modules compiled after this
+grci_status grci_register_foreign(struct grci *g, const struct grci_foreign *foreign) {
+    struct grci_compiler *compiler = &g->compiler;
+    struct grci_string name = { .ptr = foreign->name, .len = strlen(foreign->name) };
+    grci_ensure(!grci_module_desc_list_get(&compiler->module_defs, &name), GRCI_ERR_COMP, 0, "module %s already exists", foreign->name);
+    grci_ensure(compiler->module_defs.count < GRCI_MAX_MODULES, GRCI_ERR_COMP, 0, "too many modules");
+
+    struct grci_module_desc decl;
+    grci_ensure(grci_foreign_decl(compiler, foreign, &decl), GRCI_ERR_COMP, 0, "placeholder");
+    grci_module_desc_list_append(&compiler->module_defs, &decl);
+    return GRCI_OK;
+}
+
+static grci_status grci_init_submodule_states(struct grci_sim *s) {
+    struct grci_module_runtime *m = &s->module;
+    for (int i = 0; i < m->desc->part_count; i++) {
+        m->submodules[i].state_count = m->dff_off_len[i][1];
+        if (grci_string_matches(&m->desc->parts[i]->name, "Ram64K", 6)) {
+            //ram states are only allocated once asked for, see grci_submodule
+            m->submodules[i].state_count = GRCI_RAM64K_STATE_COUNT;
+            m->submodules[i].states = NULL;
+            continue;
+        }
+        grci_ensure(grci_arena_malloc(&s->sim.arena, sizeof(bool) * m->submodules[i].state_count, (void **)&m->submodules[i].states), 
+                    GRCI_ERR_MEM, 0, "placeholder");
+        memset(m->submodules[i].states, 0, sizeof(bool) * m->submodules[i].state_count);
+    }
+
+    return GRCI_OK;
+}
+
+//Follows the chunks grci_arena_malloc would make for a series of allocations.  Only the newest chunk
+//is ever allocated from, so that's all that needs tracking
+struct grci_arena_model {
+    size_t left;
+    size_t bytes;
+    int chunk_count;
+    int chunk_cap;
+};
+
+static void grci_arena_model_init(struct grci_arena_model *a) {
+    a->left = GRCI_DEFAULT_CHUNK_SIZE;
+    a->chunk_count = 1;
+    a->chunk_cap = 8;
+    a->bytes = GRCI_DEFAULT_CHUNK_SIZE + sizeof(struct grci_chunk) * a->chunk_cap;
+}
+
+static void grci_arena_model_alloc(struct grci_arena_model *a, size_t size) {
+    size_t alsize = grci_aligned_size(size);
+    if (alsize <= a->left) {
+        a->left -= alsize;
+        return;
+    }
+    size_t new_size = GRCI_DEFAULT_CHUNK_SIZE;
+    while (new_size < alsize) {
+        new_size *= 8;
+    }
+    a->bytes += new_size;
+    a->left = new_size - alsize;
+    if (++a->chunk_count > a->chunk_cap) {
+        a->bytes += sizeof(struct grci_chunk) * a->chunk_cap;
+        a->chunk_cap *= 2;
+    }
+}
+
+//the arrays of each foreign instance, in the order grci_make_module makes them
+static void grci_estimate_foreigns(const struct grci_module_desc *decl, struct grci_arena_model *a) {
+    if (decl->foreign) {
+        grci_arena_model_alloc(a, sizeof(struct grci_node*) * (decl->input_count + 1));
+        grci_arena_model_alloc(a, sizeof(struct grci_node*) * decl->output_count);
+        grci_arena_model_alloc(a, sizeof(bool) * (decl->input_count + 1));
+        grci_arena_model_alloc(a, sizeof(bool) * decl->output_count);
+        grci_arena_model_alloc(a, decl->foreign->state_size + 1);
+        return;
+    }
+    for (int i = 0; i < decl->part_count; i++) {
+        if (decl->parts[i]->foreign_count > 0) {
+            grci_estimate_foreigns(decl->parts[i], a);
+        }
+    }
+}
+
+//Replays the allocations of grci_init_module for decl, including the scaffolding that is freed again once
+//the nodes are wired.  Ram pages are counted as if all were written, and Ram64K submodule states, which
+//are only made when asked for, aren't counted
+static void grci_estimate_desc(const struct grci_module_desc *decl, struct grci_estimate *estimate) {
+    size_t nodes = (size_t) decl->node_count + decl->input_count + 3;
+    size_t fixed = sizeof(struct grci_module) + sizeof(struct grci_sim);
+    fixed += sizeof(struct grci_node) * nodes;
+    fixed += sizeof(struct grci_node*) * (decl->dff_count > 0 ? decl->dff_count : 1);
+    fixed += sizeof(bool) * (size_t) (decl->input_count + decl->output_count);
+    fixed += sizeof(struct grci_ram_page) * GRCI_RAM_PAGE_COUNT * (size_t) decl->ram_count;
+
+    struct grci_arena_model sim;
+    grci_arena_model_init(&sim);
+    grci_arena_model_alloc(&sim, sizeof(struct grci_ram64k) * decl->ram_count);
+    if (decl->foreign_count > 0) {
+        grci_arena_model_alloc(&sim, sizeof(struct grci_foreign_instance) * decl->foreign_count);
+    }
+    grci_arena_model_alloc(&sim, sizeof(struct grci_node*) * decl->input_count);
+    grci_arena_model_alloc(&sim, sizeof(struct grci_node*) * decl->output_count);
+    grci_arena_model_alloc(&sim, sizeof(struct grci_submodule) * decl->part_count);
+    grci_arena_model_alloc(&sim, sizeof(int[2]) * decl->part_count);
+
+    struct grci_arena_model build;
+    grci_arena_model_init(&build);
+    grci_arena_model_alloc(&build, sizeof(struct grci_module_instance) * (size_t) decl->instance_count);
+    grci_arena_model_alloc(&build, sizeof(struct grc_input_sink) * (size_t) decl->sink_count);
+    grci_arena_model_alloc(&build, sizeof(struct grci_node**) * (size_t) decl->sink_slot_count);
+    grci_arena_model_alloc(&build, sizeof(struct grci_node*) * (size_t) decl->output_slot_count);
+    grci_arena_model_alloc(&build, sizeof(struct grci_make_frame) * (size_t) decl->depth);
+    grci_estimate_foreigns(decl, &sim);
+    size_t wired = fixed + sim.bytes + build.bytes;
+
+    //submodule states come after the scaffolding is freed
+    for (int i = 0; i < decl->part_count; i++) {
+        if (!decl->parts[i]->is_ram64K) {
+            grci_arena_model_alloc(&sim, sizeof(bool) * decl->parts[i]->dff_count);
+        }
+    }
+    size_t done = fixed + sim.bytes;
+
+    estimate->node_count = (int) nodes;
+    estimate->dff_count = decl->dff_count;
+    estimate->ram_count = decl->ram_count;
+    estimate->bytes = wired > done ? wired : done;
+}
+
+static grci_status grci_within_limits(struct grci *g, const struct grci_module_desc *decl) {
+    struct grci_estimate e;
+    grci_estimate_desc(decl, &e);
+    grci_ensure(g->limits.max_nodes == 0 || e.node_count <= g->limits.max_nodes, GRCI_ERR_SIM, 0, 
+                "module %.*s needs %d nodes, the limit is %d", decl->name.len, decl->name.ptr, e.node_count, g->limits.max_nodes);
+    grci_ensure(g->limits.max_bytes == 0 || e.bytes <= g->limits.max_bytes, GRCI_ERR_SIM, 0, 
+                "module %.*s needs %zu bytes, the limit is %zu", decl->name.len, decl->name.ptr, e.bytes, g->limits.max_bytes);
+    return GRCI_OK;
+}
+
+//What grci_init_module would make of module_name, without making it
+grci_status grci_estimate_module(struct grci *g, const char *module_name, size_t len, struct grci_estimate *estimate) {
     struct grci_string string = { .ptr = module_name, .len = len };
-    //printf("\n");
+    const struct grci_module_desc* decl = grci_module_desc_list_get(&g->compiler.module_defs, &string);
+    grci_ensure(decl, GRCI_ERR_SIM, 0, "module %.*s does not exist", (int) len, module_name);
+    grci_estimate_desc(decl, estimate);
+    return GRCI_OK;
+}
+
+//Caps for modules made after this.  Modules over the node or byte cap aren't made, and steps past the
+//cycle cap are ignored with an error set.  Imported netlists are only held to the node and cycle caps
+void grci_set_limits(struct grci *g, const struct grci_limits *limits) {
+    g->limits = *limits;
+}
 
+//index of desc in module_defs, or -1 for descs that aren't in it, like those of imported netlists
+static int grci_pool_index(struct grci *g, const struct grci_module_desc *desc) {
     for (int i = 0; i < g->compiler.module_defs.count; i++) {
-            const struct grci_module_desc *cur = &g->compiler.module_defs.entries[i];
-            //printf("list item: %.*s\n", cur->name.len, cur->name.ptr);
+        if (&g->compiler.module_defs.entries[i] == desc) return i;
     }
+    return -1;
+}
+
+struct grci_module *grci_init_module(struct grci *g, const char *module_name, size_t len) {
+    struct grci_string string = { .ptr = module_name, .len = len };
     const struct grci_module_desc* decl = grci_module_desc_list_get(&g->compiler.module_defs, &string);
-    printf("\n");
-    if (!decl) {
-        printf("*************%.*s\n", string.len, string.ptr);
+    grci_ensure_retnull(decl, GRCI_ERR_SIM, 0, "module %.*s does not exist", (int) len, module_name);
+    grci_ensure_retnull(grci_within_limits(g, decl), GRCI_ERR_SIM, 0, "placeholder");
+
+    int pool_idx = (int) (decl - g->compiler.module_defs.entries);
+    if (g->pool[pool_idx]) {
+        struct grci_module *module = g->pool[pool_idx];
+        g->pool[pool_idx] = module->sim->pool_next;
+        g->pool_counts[pool_idx]--;
+        module->sim->step_limit = g->limits.max_cycles * 2;
+        return module;
     }
-    assert(decl);
 
+    struct grci_module *module = g->client_malloc(sizeof(struct grci_module));
     module->sim = g->client_malloc(sizeof(struct grci_sim));
+    memset(module->sim, 0, sizeof(struct grci_sim));
     module->sim->g = g;
+    module->sim->step_limit = g->limits.max_cycles * 2;
     //decl->input_count is added to total node count since inputs are NOT included during module compilation
-    grci_simulator_init(&module->sim->sim, 
-                        g->client_malloc, 
-                        g->client_realloc, 
-                        g->client_free, 
-                        decl->node_count + decl->input_count, 
-                        decl->dff_count);
-
-    struct grci_module_instance *m = &module->sim->module;
-    m->desc = decl;
-    grci_make_module(&module->sim->sim, m);
+    grci_ensure_retnull(grci_simulator_init(&module->sim->sim, 
+                                            g->client_malloc, 
+                                            g->client_realloc, 
+                                            g->client_free, 
+                                            decl->node_count + decl->input_count, 
+                                            decl->dff_count,
+                                            decl->ram_count),
+                        GRCI_ERR_MEM, 0, "placeholder");
+    if (decl->foreign_count > 0) {
+        grci_ensure_retnull(grci_arena_calloc(&module->sim->sim.arena, decl->foreign_count, sizeof(struct grci_foreign_instance),
+                                              (void**) &module->sim->sim.foreigns),
+                            GRCI_ERR_MEM, 0, "placeholder");
+        module->sim->sim.foreign_capacity = decl->foreign_count;
+    }
 
     int input_count = decl->input_count;
     int output_count = decl->output_count;
@@ -2163,39 +3099,68 @@ struct grci_module *grci_init_module(struct grci *g, const char *module_name, si
     module->input_count = input_count;
     module->outputs = g->client_malloc(sizeof(bool) * output_count);
     module->output_count = output_count;
+    memset(module->inputs, 0, sizeof(bool) * input_count);
+    memset(module->outputs, 0, sizeof(bool) * output_count);
 
-    struct grci_input_data *inputs;
-    grci_ensure_retnull(grci_arena_malloc(&module->sim->sim.arena, sizeof(struct grci_input_data) * input_count, (void**) &inputs),
-                      GRCI_ERR_MEM, 0, "placeholder");
-    assert(inputs);
-    for (int i = 0; i < input_count; i++) {
-        inputs[i] = (struct grci_input_data) { .type=GRCI_IT_INTERNAL, 
-                                               .as.obj=grci_constant_new(&module->sim->sim, 0) };
-        m->inputs[i] = inputs[i].as.obj;
-    }
+    //only what simulation needs from the top level instance is kept here, the rest is scaffolding
+    struct grci_module_runtime *rt = &module->sim->module;
+    rt->desc = decl;
+    grci_ensure_retnull(grci_module_runtime_init(rt, &module->sim->sim.arena, input_count, output_count, decl->part_count),
+                        GRCI_ERR_MEM, 0, "placeholder");
 
-    grci_set_module_inputs(m, inputs);
+    struct grci_arena build;
+    grci_ensure_retnull(grci_arena_init(&build, g->client_malloc, g->client_realloc, g->client_free),
+                        GRCI_ERR_MEM, 0, "placeholder");
 
-    //submodules
-    for (int i = 0; i < m->desc->part_count; i++) {
-        m->submodules[i].state_count = m->dff_off_len[i][1];
-        if (grci_string_matches(&decl->parts[i]->name, "Ram64K", 6)) {
-            m->submodules[i].state_count = GRCI_RAM64K_STATE_COUNT;
-        }
-        grci_ensure_retnull(grci_arena_malloc(&module->sim->sim.arena, sizeof(bool) * m->submodules[i].state_count, (void **)&m->submodules[i].states), 
-                          GRCI_ERR_MEM, 0, "placeholder");
-        memset(m->submodules[i].states, 0, sizeof(bool) * m->submodules[i].state_count);
+    struct grci_module_instance m = { .desc = decl };
+    grci_ensure_retnull(grci_make_module(&module->sim->sim, &build, &m, rt->dff_off_len),
+                        GRCI_ERR_MEM, 0, "placeholder");
+
+    for (int i = 0; i < input_count; i++) {
+        struct grci_input_data input = { .type=GRCI_IT_INTERNAL, 
+                                         .as.obj=grci_constant_new(&module->sim->sim, 0) };
+        grci_connect_input(&m, i, &input);
+        rt->inputs[i] = input.as.obj;
     }
+    memcpy(rt->outputs, m.outputs, sizeof(struct grci_node*) * output_count);
+    grci_arena_cleanup(&build);
+
+    grci_ensure_retnull(grci_init_submodule_states(module->sim), GRCI_ERR_MEM, 0, "placeholder");
 
     return module;
 }
 
+static inline struct grci_ram64k *grci_part_ram(struct grci_sim *s, int part_idx) {
+    //just grabbing first of 16 dff nodes on Ram64K outputs in order to get struct grci_ram64k*
+    struct grci_node *node = s->sim.dff_nodes[s->module.dff_off_len[part_idx][0]];
+    assert(node->type == GRCI_NT_RAM64KOUT);
+    return node->as.ram64Kout.ram;
+}
+
+//the 512K state bools of a ram are unpacked from its pages the first time they're asked for
+static grci_status grci_ram_states_alloc(struct grci_sim *s, int part_idx) {
+    struct grci_submodule *sub = &s->module.submodules[part_idx];
+    grci_ensure(grci_arena_malloc(&s->sim.arena, sizeof(bool) * sub->state_count, (void**) &sub->states),
+                GRCI_ERR_MEM, 0, "placeholder");
+
+    struct grci_ram64k *ram = grci_part_ram(s, part_idx);
+    for (int i = 0; i < GRCI_RAM64K_STATE_COUNT; i++) {
+        sub->states[i] = (grci_ram_read_byte(ram, i / 8) >> (i % 8)) & 1;
+    }
+    return GRCI_OK;
+}
+
 struct grci_submodule *grci_submodule(struct grci_module *m, const char *submodule_name, size_t len) {
     for (int i = 0; i < m->sim->module.desc->part_count; i++) {
         if (!m->sim->module.desc->part_names[i].ptr) continue;
 
         if (grci_string_matches(&m->sim->module.desc->part_names[i], submodule_name, len)) {
-            return &m->sim->module.submodules[i];
+            struct grci_submodule *sub = &m->sim->module.submodules[i];
+            if (!sub->states && grci_string_matches(&m->sim->module.desc->parts[i]->name, "Ram64K", 6)) {
+                grci_ensure_retnull(grci_ram_states_alloc(m->sim, i), GRCI_ERR_MEM, 0, "placeholder");
+                if (!sub->states) return NULL;
+            }
+            return sub;
         }
     }
 
@@ -2203,130 +3168,4427 @@ struct grci_submodule *grci_submodule(struct grci_module *m, const char *submodu
     return NULL;
 }
 
-bool grci_step_module(struct grci_module *m) {
-    //set module inputs
-    for (int i = 0; i < m->sim->module.desc->input_count; i++) {
-        m->sim->module.inputs[i]->as.constant = m->inputs[i];
-    }
-
-    //set submodule states
-    for (int i = 0; i < m->sim->module.desc->part_count; i++) {
-        if (!m->sim->module.desc->part_names[i].ptr) continue;
-        struct grci_submodule *sub = &m->sim->module.submodules[i];
+//Writes submodule states into the simulation before a step.  Returns true if the host changed any of them
+static bool grci_sync_states_in(struct grci_sim *s) {
+    bool changed = false;
+    for (int i = 0; i < s->module.desc->part_count; i++) {
+        if (!s->module.desc->part_names[i].ptr) continue;
+        struct grci_submodule *sub = &s->module.submodules[i];
 
-        if (grci_string_matches(&m->sim->module.desc->parts[i]->name, "Ram64K", 6)) {
-            //just grabbing first of 16 dff nodes on Ram64K outputs in order to get struct grci_ram64k*
-            struct grci_node *node = m->sim->sim.dff_nodes[m->sim->module.dff_off_len[i][0]];
-            assert(node->type == GRCI_NT_RAM64KOUT);
-            struct grci_ram64k *ram = node->as.ram64Kout.ram;
+        if (grci_string_matches(&s->module.desc->parts[i]->name, "Ram64K", 6)) {
+            if (!sub->states) continue;
+            struct grci_ram64k *ram = grci_part_ram(s, i);
           
-            char c = 0;
+            //unchanged bytes are skipped so that shared pages stay shared
+            unsigned char c = 0;
             for (int i = 0; i < GRCI_RAM64K_STATE_COUNT; i++) {
                 c |= sub->states[i] << (i % 8);
                 if (i % 8 == 7) {
-                    ram->data[i / 8] = c;
+                    changed = changed || grci_ram_read_byte(ram, i / 8) != c;
+                    grci_ram_write_byte(ram, i / 8, c);
                     c = 0;
                 }
             }
 
         } else {
-            int dff_off = m->sim->module.dff_off_len[i][0];
-            int dff_len = m->sim->module.dff_off_len[i][1];
+            int dff_off = s->module.dff_off_len[i][0];
+            int dff_len = s->module.dff_off_len[i][1];
             for (int j = 0; j < dff_len; j++) {
-                m->sim->sim.dff_nodes[j + dff_off]->as.dff.last_state = sub->states[j];
-                m->sim->sim.dff_nodes[j + dff_off]->cached_state = sub->states[j];
+                struct grci_node *node = s->sim.dff_nodes[j + dff_off];
+                changed = changed || node->as.dff.last_state != sub->states[j];
+                node->as.dff.last_state = sub->states[j];
+                node->cached_state = sub->states[j];
             }
         }
     }
+    return changed;
+}
 
-    struct grci_simulator *sim = &m->sim->sim;
+static void grci_sync_states_out(struct grci_sim *s) {
+    for (int i = 0; i < s->module.desc->part_count; i++) {
+        if (!s->module.desc->part_names[i].ptr) continue;
+        struct grci_submodule *sub = &s->module.submodules[i];
 
-    sim->clock->as.constant = sim->clock->as.constant == 0 ? 1: 0;
+        if (grci_string_matches(&s->module.desc->parts[i]->name, "Ram64K", 6)) {
+            if (!sub->states) continue;
+            struct grci_ram64k *ram = grci_part_ram(s, i);
+            
+            for (int i = 0; i < GRCI_RAM64K_STATE_COUNT; i++) {
+                unsigned char c = grci_ram_read_byte(ram, i / 8);
+                sub->states[i] = (c >> (i % 8)) & 1;
+            }
+        } else {
+            int dff_off = s->module.dff_off_len[i][0];
+            int dff_len = s->module.dff_off_len[i][1];
+            for (int j = 0; j < dff_len; j++) {
+                sub->states[j] = s->sim.dff_nodes[j + dff_off]->as.dff.last_state;
+            }
+        }
+    }
+}
+
+static void grci_checkpoint_free(struct grci_sim *s, struct grci_checkpoint *c) {
+    struct grci_simulator *sim = &s->sim;
+    for (int r = 0; r < sim->ram_count; r++) {
+        for (int i = 0; i < GRCI_RAM_PAGE_COUNT; i++) {
+            grci_ram_page_release(&sim->rams[r], c->pages[r * GRCI_RAM_PAGE_COUNT + i]);
+        }
+    }
+    sim->arena.free(c->pages);
+    sim->arena.free(c->bits);
+    s->checkpoints.used -= c->size;
+}
 
-    //not reseting nodes recursively since that's too slow
-    for (int k = 0; k < sim->node_count; k++) {
-        sim->nodes[k].visited = false;
+static void grci_checkpoints_clear(struct grci_sim *s) {
+    struct grci_checkpoints *cp = &s->checkpoints;
+    for (int i = 0; i < cp->count; i++) {
+        grci_checkpoint_free(s, &cp->entries[i]);
     }
+    s->sim.arena.free(cp->entries);
+    s->sim.arena.free(cp->inputs);
+    memset(cp, 0, sizeof(struct grci_checkpoints));
+}
 
-    //updating all flip flops first prevents bug with combinationals gates getting old data when evaluated first
-    if (sim->clock->as.constant) {
-        for (int k = 0; k < sim->dff_node_count; k++) {
-            sim->dff_nodes[k]->visited = false;
-            grci_eval_dff(sim->dff_nodes[k], true);
+static inline void grci_put_bit(unsigned char *bits, int idx, bool value) {
+    bits[idx / 8] |= value << (idx % 8);
+}
+
+static inline bool grci_get_bit(const unsigned char *bits, int idx) {
+    return (bits[idx / 8] >> (idx % 8)) & 1;
+}
+
+static inline int grci_checkpoint_bit_count(const struct grci_sim *s) {
+    return 1 + s->sim.dff_node_count * 2 + s->module.desc->output_count;
+}
+
+//Over budget, the oldest checkpoints are dropped along with the inputs recorded before the next one, so
+//seeking stays within one interval of replay and reaches back as far as the budget allows.  The newest
+//checkpoint is always kept
+static void grci_checkpoints_evict(struct grci_sim *s) {
+    struct grci_checkpoints *cp = &s->checkpoints;
+    int drop = 0;
+    while (cp->used > cp->budget && cp->count - drop > 1) {
+        grci_checkpoint_free(s, &cp->entries[drop++]);
+    }
+    if (drop == 0) return;
+    cp->count -= drop;
+    memmove(cp->entries, cp->entries + drop, sizeof(struct grci_checkpoint) * cp->count);
+
+    uint64_t steps = cp->entries[0].step - cp->input_base;
+    memmove(cp->inputs, cp->inputs + (size_t) steps * cp->input_bytes, (size_t) (cp->input_capacity - steps) * cp->input_bytes);
+    cp->input_base = cp->entries[0].step;
+
+    //at most the current step has been recorded past step_count
+    uint64_t live = s->step_count + 1 - cp->input_base;
+    uint64_t capacity = cp->input_capacity;
+    while (capacity > 256 && live <= capacity / 4) {
+        capacity /= 2;
+    }
+    unsigned char *inputs = capacity < cp->input_capacity ? s->sim.arena.realloc(cp->inputs, (size_t) capacity * cp->input_bytes) : NULL;
+    if (inputs) {
+        cp->used -= (size_t) (cp->input_capacity - capacity) * cp->input_bytes;
+        cp->inputs = inputs;
+        cp->input_capacity = capacity;
+    }
+}
+
+//Rams are captured by taking references to their pages, so a checkpoint only costs the pages
+//written since prev
+static grci_status grci_checkpoint_fill(struct grci_sim *s, struct grci_checkpoint *c, const bool *outputs, 
+                                        const struct grci_checkpoint *prev) {
+    struct grci_simulator *sim = &s->sim;
+    int bit_bytes = (grci_checkpoint_bit_count(s) + 7) / 8;
+    c->step = s->step_count;
+    c->bits = sim->arena.malloc(bit_bytes);
+    c->pages = sim->arena.malloc(sizeof(struct grci_ram_page*) * GRCI_RAM_PAGE_COUNT * (sim->ram_count > 0 ? sim->ram_count : 1));
+    if (!c->bits || !c->pages) {
+        sim->arena.free(c->bits);
+        sim->arena.free(c->pages);
+        grci_ensure(false, GRCI_ERR_MEM, 0, "malloc failed");
+    }
+
+    memset(c->bits, 0, bit_bytes);
+    int bit = 0;
+    grci_put_bit(c->bits, bit++, sim->clock->as.constant);
+    for (int i = 0; i < sim->dff_node_count; i++) {
+        grci_put_bit(c->bits, bit++, sim->dff_nodes[i]->as.dff.last_state);
+        grci_put_bit(c->bits, bit++, sim->dff_nodes[i]->cached_state);
+    }
+    for (int i = 0; i < s->module.desc->output_count; i++) {
+        grci_put_bit(c->bits, bit++, outputs[i]);
+    }
 
-            for (int k = 0; k < sim->node_count; k++) {
-                if (sim->nodes[k].type != GRCI_NT_DFF)
-                    sim->nodes[k].visited = false;
+    c->size = bit_bytes + sizeof(struct grci_ram_page*) * GRCI_RAM_PAGE_COUNT * sim->ram_count;
+    for (int r = 0; r < sim->ram_count; r++) {
+        for (int i = 0; i < GRCI_RAM_PAGE_COUNT; i++) {
+            struct grci_ram_page *page = sim->rams[r].pages[i];
+            if (page != &grci_zero_page) {
+                page->refs++;
+                if (!prev || prev->pages[r * GRCI_RAM_PAGE_COUNT + i] != page) {
+                    c->size += sizeof(struct grci_ram_page);
+                }
             }
+            c->pages[r * GRCI_RAM_PAGE_COUNT + i] = page;
         }
+    }
+    return GRCI_OK;
+}
 
-        //setting state of flip flops to new value
-        for (int k = 0; k < sim->dff_node_count; k++) {
-            sim->dff_nodes[k]->as.dff.last_state = sim->dff_nodes[k]->cached_state;
+//puts the clock, dffs, outputs and rams back the way they were when c was filled
+static void grci_checkpoint_restore(struct grci_sim *s, const struct grci_checkpoint *c, bool *outputs) {
+    struct grci_simulator *sim = &s->sim;
+    int bit = 0;
+    sim->clock->as.constant = grci_get_bit(c->bits, bit++);
+    sim->clock->cached_state = sim->clock->as.constant;
+    for (int i = 0; i < sim->dff_node_count; i++) {
+        sim->dff_nodes[i]->as.dff.last_state = grci_get_bit(c->bits, bit++);
+        sim->dff_nodes[i]->cached_state = grci_get_bit(c->bits, bit++);
+    }
+    for (int i = 0; i < s->module.desc->output_count; i++) {
+        outputs[i] = grci_get_bit(c->bits, bit++);
+    }
+
+    for (int r = 0; r < sim->ram_count; r++) {
+        for (int i = 0; i < GRCI_RAM_PAGE_COUNT; i++) {
+            struct grci_ram_page *page = c->pages[r * GRCI_RAM_PAGE_COUNT + i];
+            if (page != &grci_zero_page) {
+                page->refs++;
+            }
+            grci_ram_page_release(&sim->rams[r], sim->rams[r].pages[i]);
+            sim->rams[r].pages[i] = page;
         }
     }
+}
 
+static grci_status grci_checkpoint_take(struct grci_sim *s, const bool *outputs) {
+    struct grci_simulator *sim = &s->sim;
+    struct grci_checkpoints *cp = &s->checkpoints;
 
-    for (int k = 0; k < m->sim->module.desc->output_count; k++) {
-        bool v = grci_eval_node(m->sim->module.outputs[k]);
-        m->outputs[k] = v;
+    //a checkpoint of the same step is replaced, which happens when the host writes state between steps
+    if (cp->count > 0 && cp->entries[cp->count - 1].step == s->step_count) {
+        cp->count--;
+        grci_checkpoint_free(s, &cp->entries[cp->count]);
     }
 
-    //set submodule states
-    for (int i = 0; i < m->sim->module.desc->part_count; i++) {
-        if (!m->sim->module.desc->part_names[i].ptr) continue;
-        struct grci_submodule *sub = &m->sim->module.submodules[i];
+    if (cp->count == cp->capacity) {
+        int capacity = cp->capacity == 0 ? 8 : cp->capacity * 2;
+        struct grci_checkpoint *entries = sim->arena.realloc(cp->entries, sizeof(struct grci_checkpoint) * capacity);
+        grci_ensure(entries, GRCI_ERR_MEM, 0, "realloc failed");
+        cp->entries = entries;
+        cp->capacity = capacity;
+    }
 
-        if (grci_string_matches(&m->sim->module.desc->parts[i]->name, "Ram64K", 6)) {
-            //just grabbing first of 16 dff nodes on Ram64K outputs in order to get struct grci_ram64k*
-            struct grci_node *node = m->sim->sim.dff_nodes[m->sim->module.dff_off_len[i][0]];
-            assert(node->type == GRCI_NT_RAM64KOUT);
-            struct grci_ram64k *ram = node->as.ram64Kout.ram;
-            
-            for (int i = 0; i < GRCI_RAM64K_STATE_COUNT; i++) {
-                char c = ram->data[i / 8];
-                sub->states[i] = (c >> (i % 8)) & 1;
-            }
-        } else {
-            int dff_off = m->sim->module.dff_off_len[i][0];
-            int dff_len = m->sim->module.dff_off_len[i][1];
-            for (int j = 0; j < dff_len; j++) {
-                sub->states[j] = m->sim->sim.dff_nodes[j + dff_off]->as.dff.last_state;
-            }
-        }
+    const struct grci_checkpoint *prev = cp->count > 0 ? &cp->entries[cp->count - 1] : NULL;
+    if (!grci_checkpoint_fill(s, &cp->entries[cp->count], outputs, prev)) return GRCI_ERR;
+    cp->used += cp->entries[cp->count].size;
+    cp->count++;
+    grci_checkpoints_evict(s);
+    return GRCI_OK;
+}
+
+static grci_status grci_record_inputs(struct grci_sim *s, const bool *inputs) {
+    struct grci_simulator *sim = &s->sim;
+    struct grci_checkpoints *cp = &s->checkpoints;
+    if (s->step_count - cp->input_base == cp->input_capacity) {
+        uint64_t capacity = cp->input_capacity * 2;
+        unsigned char *history = sim->arena.realloc(cp->inputs, (size_t) capacity * cp->input_bytes);
+        grci_ensure(history, GRCI_ERR_MEM, 0, "realloc failed");
+        cp->used += (size_t) (capacity - cp->input_capacity) * cp->input_bytes;
+        cp->inputs = history;
+        cp->input_capacity = capacity;
+        grci_checkpoints_evict(s);
     }
 
-    return sim->clock->as.constant;
+    unsigned char *packed = cp->inputs + (size_t) (s->step_count - cp->input_base) * cp->input_bytes;
+    memset(packed, 0, cp->input_bytes);
+    for (int i = 0; i < s->module.desc->input_count; i++) {
+        grci_put_bit(packed, i, inputs[i]);
+    }
+    return GRCI_OK;
 }
 
-void grci_destroy_module(struct grci_module *m) {
-    grci_simulator_cleanup(&m->sim->sim);
-    void (*free)(void*) = m->sim->g->client_free;
-    free(m->sim);
-    free(m);
+static void grci_journal_open_group(struct grci_journal *j) {
+    j->open = 0;
+    grci_journal_push(j, GRCI_JOURNAL_GROUP << 30);
 }
-void grci_cleanup(struct grci *g) {
-    g->client_free(g);
+
+static void grci_journal_reset(struct grci_journal *j) {
+    j->head = 0;
+    j->count = 0;
+    j->groups = 0;
+    j->overflow = false;
+    grci_journal_open_group(j);
 }
 
-const char *grci_err(void) {
-    return grci_err_buf;
+static void grci_journal_clear(struct grci_sim *s) {
+    struct grci_journal *j = &s->journal;
+    for (int r = 0; r < s->sim.ram_count; r++) {
+        s->sim.rams[r].journal = NULL;
+    }
+    s->sim.arena.free(j->words);
+    s->sim.arena.free(j->before);
+    memset(j, 0, sizeof(struct grci_journal));
 }
 
-void grci_set_input(struct grci_module *m, int idx, bool value) {
-    m->inputs[idx] = value;
+//called at the start of a step, before submodule states are written, so host changes to them are journaled too
+static void grci_journal_begin(struct grci_sim *s, const bool *outputs) {
+    struct grci_journal *j = &s->journal;
+    int dff_count = s->sim.dff_node_count;
+    for (int i = 0; i < dff_count; i++) {
+        j->before[i * 2] = s->sim.dff_nodes[i]->as.dff.last_state;
+        j->before[i * 2 + 1] = s->sim.dff_nodes[i]->cached_state;
+    }
+    memcpy(j->before + dff_count * 2, outputs, sizeof(bool) * s->module.desc->output_count);
 }
 
-bool grci_get_output(struct grci_module *m, int idx) {
-    return m->outputs[idx];
+//Closes the step's group and opens the next one.  Ram writes made by the host between steps land in
+//the open group and are undone along with the step before them
+static void grci_journal_end(struct grci_sim *s, const bool *outputs) {
+    struct grci_journal *j = &s->journal;
+    int dff_count = s->sim.dff_node_count;
+    for (int i = 0; i < dff_count; i++) {
+        bool last = j->before[i * 2];
+        bool cached = j->before[i * 2 + 1];
+        struct grci_node *n = s->sim.dff_nodes[i];
+        if (n->as.dff.last_state != last || n->cached_state != cached) {
+            grci_journal_push(j, GRCI_JOURNAL_DFF << 30 | (uint32_t) cached << 29 | (uint32_t) last << 28 | (uint32_t) i);
+        }
+    }
+    for (int i = 0; i < s->module.desc->output_count; i++) {
+        if (outputs[i] != j->before[dff_count * 2 + i]) {
+            grci_journal_push(j, GRCI_JOURNAL_OUTPUT << 30 | (uint32_t) !outputs[i] << 28 | (uint32_t) i);
+        }
+    }
+
+    if (j->overflow) {
+        grci_journal_reset(j);
+        return;
+    }
+    uint32_t len = (uint32_t) j->open - 1;
+    j->words[(j->head + j->count - j->open) % j->capacity] = GRCI_JOURNAL_GROUP << 30 | len;
+    grci_journal_push(j, GRCI_JOURNAL_GROUP << 30 | len);
+    if (j->overflow) {
+        grci_journal_reset(j);
+        return;
+    }
+    j->groups++;
+    grci_journal_open_group(j);
 }
-void grci_set_state(struct grci_submodule *m, int idx, bool value) {
-    m->states[idx] = value;
+
+static inline uint32_t grci_journal_pop(struct grci_journal *j) {
+    j->count--;
+    return j->words[(j->head + j->count) % j->capacity];
 }
-bool grci_get_state(struct grci_submodule *m, int idx) {
-    return m->states[idx];
+
+//undoes the newest count change words
+static void grci_journal_undo(struct grci_sim *s, bool *outputs, size_t count) {
+    struct grci_journal *j = &s->journal;
+    while (count > 0) {
+        uint32_t w = grci_journal_pop(j);
+        count--;
+        uint32_t idx = w & GRCI_JOURNAL_INDEX_MASK;
+        switch (GRCI_JOURNAL_KIND(w)) {
+        case GRCI_JOURNAL_DFF:
+            s->sim.dff_nodes[idx]->as.dff.last_state = (w >> 28) & 1;
+            s->sim.dff_nodes[idx]->cached_state = (w >> 29) & 1;
+            break;
+        case GRCI_JOURNAL_OUTPUT:
+            outputs[idx] = (w >> 28) & 1;
+            break;
+        case GRCI_JOURNAL_RAM: {
+            uint32_t data = grci_journal_pop(j);
+            count--;
+            struct grci_ram64k *ram = &s->sim.rams[w & ~(3u << 30)];
+            ram->journal = NULL;
+            grci_ram_write_byte(ram, data >> 8, data & 0xff);
+            ram->journal = j;
+            break;
+        }
+        default:
+            assert(false && "journal is corrupt");
+            break;
+        }
+    }
+}
+
+//Levelized evaluation.  Instead of walking the graph recursively from every dff and output, nands
+//are put in an order where every nand comes after its inputs and evaluated once per phase into a
+//byte per node.  Rams can't be expressed as nands, so they split the schedule into segments and are
+//evaluated in C between them.  On x86-64 each segment is compiled to machine code, elsewhere the
+//same schedule is run by a loop over the ops.
+//ints per op: node type, node, a, b, sel, lanes, broadcast.  An op with 4 or 8 lanes computes that many
+//consecutive nodes at once from operands that are either consecutive too or, when their bit in broadcast
+//is set, the same node
+#define GRCI_JIT_OP_SIZE 7
+
+struct grci_jit_segment {
+    int op_start;
+    int op_end;
+    int ram_start; //rams evaluated after the segment, as indices into ram_order
+    int ram_end;
+    size_t code_off;
+};
+
+struct grci_jit {
+    enum grci_engine engine;
+    unsigned char *values; //node values, by node index
+    int *ops;
+    int op_count;
+    int *ram_order;
+    struct grci_jit_segment *segments;
+    int segment_count;
+
+    unsigned char *code;
+    size_t code_size;
+
+    //event driven only: the ops reading each node, and the ops with an input that changed
+    int *fanout_start;
+    int *fanout;
+    unsigned char *dirty;
+    uint64_t evaluated; //ops, for the warm-up of GRCI_ENGINE_AUTO
+};
+
+static void grci_jit_free(struct grci_simulator *sim, struct grci_jit *jit) {
+    if (!jit) return;
+#if defined(GRCI_JIT_X86_64)
+    if (jit->code) {
+        munmap(jit->code, jit->code_size);
+    }
+#endif
+    sim->arena.free(jit->values);
+    sim->arena.free(jit->ops);
+    sim->arena.free(jit->ram_order);
+    sim->arena.free(jit->segments);
+    sim->arena.free(jit->fanout_start);
+    sim->arena.free(jit->fanout);
+    sim->arena.free(jit->dirty);
+    sim->arena.free(jit);
+}
+
+//ops are sorted by level and then node within a segment, which is still a valid evaluation order
+//and puts the bits of a lifted bus (see GRCI_ORDER_LANES) next to each other
+static int grci_jit_op_cmp(const void *l, const void *r) {
+    const int *a = l;
+    const int *b = r;
+    if (a[5] != b[5]) return a[5] < b[5] ? -1 : 1;
+    return a[1] < b[1] ? -1 : a[1] > b[1];
+}
+
+static inline int grci_gate_operand_count(int type) {
+    return type == GRCI_NT_NOT ? 1 : type == GRCI_NT_MUX ? 3 : 2;
+}
+
+//Word level lifting.  Eight (or else four) ops of the same kind at the same level writing consecutive nodes,
+//with each operand either consecutive or shared, are replaced with one op over all the lanes.  Ops at the
+//same level can't depend on each other, so a carry chain never groups and stays bit level
+static void grci_jit_group_lanes(struct grci_jit *jit) {
+    int w = 0;
+    for (int s = 0; s < jit->segment_count; s++) {
+        struct grci_jit_segment *seg = &jit->segments[s];
+        int i = seg->op_start;
+        seg->op_start = w;
+        while (i < seg->op_end) {
+            const int *first = &jit->ops[i * GRCI_JIT_OP_SIZE];
+            int operand_count = grci_gate_operand_count(first[0]);
+            int broadcast = 0;
+            int lanes = 8;
+            for (; lanes > 1; lanes /= 2) {
+                bool ok = i + lanes <= seg->op_end;
+                broadcast = 0;
+                for (int l = 1; ok && l < lanes; l++) {
+                    const int *op = &jit->ops[(i + l) * GRCI_JIT_OP_SIZE];
+                    ok = op[0] == first[0] && op[5] == first[5] && op[1] == first[1] + l;
+                    for (int k = 0; ok && k < operand_count; k++) {
+                        int d = op[2 + k] - first[2 + k];
+                        if (l == 1 && d == 0) broadcast |= 1 << k;
+                        ok = d == ((broadcast >> k) & 1 ? 0 : l);
+                    }
+                }
+                if (ok && lanes >= 4) break;
+            }
+
+            int *out = &jit->ops[w * GRCI_JIT_OP_SIZE];
+            memmove(out, first, sizeof(int) * GRCI_JIT_OP_SIZE);
+            out[5] = lanes >= 4 ? lanes : 1;
+            out[6] = lanes >= 4 ? broadcast : 0;
+            i += out[5];
+            w++;
+        }
+        seg->op_end = w;
+    }
+    jit->op_count = w;
 }
 
+//Kahn's algorithm over the gates.  Rams are only evaluated once no nand is left that can go, so that
+//there are as few segments as possible.  Anything left unscheduled is on a combinational loop
+static grci_status grci_jit_schedule(struct grci_simulator *sim, struct grci_jit *jit) {
+    int n = sim->node_count;
+    int *pending, *users_start, *users, *queue, *ram_pending, *level;
+    struct grci_arena scratch;
+    grci_ensure(grci_arena_init(&scratch, sim->arena.malloc, sim->arena.realloc, sim->arena.free), GRCI_ERR_MEM, 0, "placeholder");
+    bool ok = grci_arena_calloc(&scratch, n, sizeof(int), (void**) &pending) &&
+              grci_arena_calloc(&scratch, n, sizeof(int), (void**) &level) &&
+              grci_arena_calloc(&scratch, n + 1, sizeof(int), (void**) &users_start) &&
+              grci_arena_malloc(&scratch, sizeof(int) * (n + 1), (void**) &queue) &&
+              grci_arena_calloc(&scratch, sim->ram_count + 1, sizeof(int), (void**) &ram_pending);
+
+    //users of each node: gates, and rams encoded as -(ram index) - 1
+#define GRCI_FOR_EACH_EDGE(EDGE) \
+    for (int i = 0; i < n; i++) { \
+        struct grci_node **slots[3]; \
+        int operand_count = grci_node_operands(&sim->nodes[i], slots); \
+        for (int k = 0; k < operand_count; k++) { \
+            EDGE(*slots[k] - sim->nodes, i); \
+        } \
+    } \
+    for (int r = 0; r < sim->ram_count; r++) { \
+        for (int k = 0; k < 16; k++) { \
+            EDGE(sim->rams[r].inputs[k] - sim->nodes, -r - 1); \
+            EDGE(sim->rams[r].addrs[k] - sim->nodes, -r - 1); \
+        } \
+        EDGE(sim->rams[r].load - sim->nodes, -r - 1); \
+    }
+#define GRCI_COUNT_EDGE(from, to) (users_start[(from) + 1]++)
+#define GRCI_FILL_EDGE(from, to) (users[fill[(from)]++] = (to))
+
+    if (ok) {
+        GRCI_FOR_EACH_EDGE(GRCI_COUNT_EDGE)
+        for (int i = 0; i < n; i++) {
+            users_start[i + 1] += users_start[i];
+        }
+    }
+    int *fill;
+    ok = ok && grci_arena_malloc(&scratch, sizeof(int) * (users_start[n] + 1), (void**) &users) &&
+               grci_arena_malloc(&scratch, sizeof(int) * n, (void**) &fill);
+    if (ok) {
+        memcpy(fill, users_start, sizeof(int) * n);
+        GRCI_FOR_EACH_EDGE(GRCI_FILL_EDGE)
+    }
+#undef GRCI_FILL_EDGE
+#undef GRCI_COUNT_EDGE
+#undef GRCI_FOR_EACH_EDGE
+
+    int gate_count = 0;
+    for (int i = 0; ok && i < n; i++) {
+        struct grci_node **slots[3];
+        pending[i] = grci_node_operands(&sim->nodes[i], slots);
+        if (pending[i] > 0) {
+            gate_count++;
+        }
+    }
+    jit->ops = sim->arena.malloc(sizeof(int) * GRCI_JIT_OP_SIZE * (gate_count + 1));
+    jit->ram_order = sim->arena.malloc(sizeof(int) * (sim->ram_count + 1));
+    jit->segments = sim->arena.malloc(sizeof(struct grci_jit_segment) * (sim->ram_count + 1));
+    ok = ok && jit->ops && jit->ram_order && jit->segments;
+    if (!ok) {
+        grci_arena_cleanup(&scratch);
+        grci_ensure(false, GRCI_ERR_MEM, 0, "malloc failed");
+    }
+
+    //constants, dffs and ram outputs are known at the start of a phase
+    int head = 0;
+    int tail = 0;
+    for (int i = 0; i < n; i++) {
+        if (sim->nodes[i].type == GRCI_NT_CONSTANT || sim->nodes[i].type == GRCI_NT_DFF) {
+            queue[tail++] = i;
+        }
+    }
+    for (int r = 0; r < sim->ram_count; r++) {
+        ram_pending[r] = 33;
+    }
+
+    int ready_rams = 0;
+    int ram_done = 0;
+    struct grci_jit_segment *seg = &jit->segments[0];
+    *seg = (struct grci_jit_segment) { .op_start = 0, .op_end = 0, .ram_start = 0, .ram_end = 0 };
+    jit->segment_count = 1;
+    while (true) {
+        while (head < tail) {
+            int v = queue[head++];
+            struct grci_node **slots[3];
+            int operand_count = grci_node_operands(&sim->nodes[v], slots);
+            if (operand_count > 0) {
+                int *op = &jit->ops[jit->op_count * GRCI_JIT_OP_SIZE];
+                op[0] = sim->nodes[v].type;
+                op[1] = v;
+                for (int k = 0; k < 3; k++) {
+                    op[2 + k] = (int) (*slots[k < operand_count ? k : 0] - sim->nodes);
+                    if (level[op[2 + k]] >= level[v]) {
+                        level[v] = level[op[2 + k]] + 1;
+                    }
+                }
+                op[5] = level[v]; //sort key until lanes are grouped
+                op[6] = 0;
+                jit->op_count++;
+            }
+            for (int u = users_start[v]; u < users_start[v + 1]; u++) {
+                int user = users[u];
+                if (user >= 0) {
+                    if (--pending[user] == 0) queue[tail++] = user;
+                } else if (--ram_pending[-user - 1] == 0) {
+                    jit->ram_order[ram_done + ready_rams] = -user - 1;
+                    ready_rams++;
+                }
+            }
+        }
+        seg->op_end = jit->op_count;
+        qsort(&jit->ops[seg->op_start * GRCI_JIT_OP_SIZE], seg->op_end - seg->op_start, sizeof(int) * GRCI_JIT_OP_SIZE, grci_jit_op_cmp);
+        if (ready_rams == 0) break;
+
+        //every ram that became ready is evaluated, then its outputs feed a new segment
+        seg->ram_start = ram_done;
+        seg->ram_end = ram_done + ready_rams;
+        for (int i = seg->ram_start; i < seg->ram_end; i++) {
+            struct grci_ram64k *ram = &sim->rams[jit->ram_order[i]];
+            for (int k = 0; k < 16; k++) {
+                queue[tail++] = (int) (ram->outputs[k] - sim->nodes);
+            }
+        }
+        ram_done += ready_rams;
+        ready_rams = 0;
+        seg = &jit->segments[jit->segment_count++];
+        *seg = (struct grci_jit_segment) { .op_start = jit->op_count, .op_end = jit->op_count, .ram_start = ram_done, .ram_end = ram_done };
+    }
+    grci_arena_cleanup(&scratch);
+
+    grci_ensure(jit->op_count == gate_count && ram_done == sim->ram_count, GRCI_ERR_SIM, 0, 
+                "%d gates are on combinational loops, which can't be levelized", gate_count - jit->op_count);
+    grci_jit_group_lanes(jit);
+    return GRCI_OK;
+}
+
+#if defined(GRCI_JIT_X86_64)
+//Each segment becomes a function taking the node values in rdi.  A nand is
+//    movzx eax, byte [rdi + a]
+//    and al, byte [rdi + b]
+//    xor al, 1
+//    mov byte [rdi + node], al
+//and the load is skipped when an input is the gate computed just before, which is still in al.
+//Fused gates swap the and for or/xor, and a mux is a ^ ((a ^ b) & sel) using ecx.
+//Ops over 8 or 4 lanes do the same with 64 or 32 bit loads into rax, rcx and r8.  rdx holds a 1 in every
+//byte, both to invert lanes and to copy a shared operand into every lane with imul
+static inline unsigned char *grci_emit_disp(unsigned char *c, int disp) {
+    memcpy(c, &disp, 4);
+    return c + 4;
+}
+
+//REX prefix for a 64 bit (w) operation with reg in the modrm reg field, or nothing if none is needed
+static inline unsigned char *grci_emit_rex(unsigned char *c, bool w, bool r) {
+    if (w || r) *c++ = 0x40 | (w ? 0x08 : 0) | (r ? 0x04 : 0);
+    return c;
+}
+
+//reg is 0 for rax, 1 for rcx or 8 for r8
+static unsigned char *grci_emit_lane_load(unsigned char *c, bool wide, int reg, int node, bool broadcast) {
+    unsigned char field = (reg & 7) << 3;
+    if (broadcast) {
+        c = grci_emit_rex(c, false, reg == 8);
+        *c++ = 0x0f; *c++ = 0xb6; *c++ = 0x87 | field; c = grci_emit_disp(c, node); //movzx reg32, byte [rdi + node]
+        c = grci_emit_rex(c, wide, reg == 8);
+        *c++ = 0x0f; *c++ = 0xaf; *c++ = 0xc2 | field;                              //imul reg, rdx
+    } else {
+        c = grci_emit_rex(c, wide, reg == 8);
+        *c++ = 0x8b; *c++ = 0x87 | field; c = grci_emit_disp(c, node);              //mov reg, [rdi + node]
+    }
+    return c;
+}
+
+//op rm, reg on two registers
+static inline unsigned char *grci_emit_lane_rr(unsigned char *c, bool wide, unsigned char opcode, int rm, int reg) {
+    c = grci_emit_rex(c, wide, reg == 8);
+    *c++ = opcode; *c++ = 0xc0 | ((reg & 7) << 3) | rm;
+    return c;
+}
+
+static unsigned char *grci_emit_lane_op(unsigned char *c, const int *op) {
+    enum { RAX = 0, RCX = 1, RDX = 2, R8 = 8 };
+    enum { AND = 0x21, OR = 0x09, XOR = 0x31 };
+    int type = op[0];
+    bool wide = op[5] == 8;
+    c = grci_emit_lane_load(c, wide, RAX, op[2], op[6] & 1);
+    if (type != GRCI_NT_NOT) {
+        c = grci_emit_lane_load(c, wide, RCX, op[3], op[6] & 2);
+    }
+    switch (type) {
+    case GRCI_NT_NAND:
+    case GRCI_NT_AND:
+        c = grci_emit_lane_rr(c, wide, AND, RAX, RCX);
+        break;
+    case GRCI_NT_OR:
+        c = grci_emit_lane_rr(c, wide, OR, RAX, RCX);
+        break;
+    case GRCI_NT_XOR:
+    case GRCI_NT_XNOR:
+        c = grci_emit_lane_rr(c, wide, XOR, RAX, RCX);
+        break;
+    case GRCI_NT_MUX:
+        c = grci_emit_lane_load(c, wide, R8, op[4], op[6] & 4);
+        c = grci_emit_lane_rr(c, wide, XOR, RCX, RAX);
+        c = grci_emit_lane_rr(c, wide, AND, RCX, R8);
+        c = grci_emit_lane_rr(c, wide, XOR, RAX, RCX);
+        break;
+    default:
+        break;
+    }
+    if (type == GRCI_NT_NAND || type == GRCI_NT_NOT || type == GRCI_NT_XNOR) {
+        c = grci_emit_lane_rr(c, wide, XOR, RAX, RDX);
+    }
+    c = grci_emit_rex(c, wide, false);
+    *c++ = 0x89; *c++ = 0x87; c = grci_emit_disp(c, op[1]); //mov [rdi + node], rax
+    return c;
+}
+
+static grci_status grci_jit_emit(struct grci_jit *jit) {
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    jit->code_size = ((size_t) jit->op_count * 64 + jit->segment_count * 11 + page) / page * page;
+    void *code = mmap(NULL, jit->code_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    grci_ensure(code != MAP_FAILED, GRCI_ERR_MEM, 0, "mmap failed");
+    jit->code = code;
+
+    unsigned char *c = jit->code;
+    for (int s = 0; s < jit->segment_count; s++) {
+        struct grci_jit_segment *seg = &jit->segments[s];
+        seg->code_off = c - jit->code;
+        for (int i = seg->op_start; i < seg->op_end; i++) {
+            if (jit->ops[i * GRCI_JIT_OP_SIZE + 5] > 1) {
+                uint64_t ones = 0x0101010101010101ull;
+                *c++ = 0x48; *c++ = 0xba; memcpy(c, &ones, 8); c += 8; //mov rdx, ones
+                break;
+            }
+        }
+        int in_al = -1;
+        for (int i = seg->op_start; i < seg->op_end; i++) {
+            const int *op = &jit->ops[i * GRCI_JIT_OP_SIZE];
+            if (op[5] > 1) {
+                c = grci_emit_lane_op(c, op);
+                in_al = -1;
+                continue;
+            }
+            int type = op[0];
+            int node = op[1];
+            int a = op[2];
+            int b = op[3];
+            if (b == in_al && type != GRCI_NT_NOT && type != GRCI_NT_MUX) {
+                b = a;
+                a = in_al;
+            }
+            if (a != in_al) {
+                *c++ = 0x0f; *c++ = 0xb6; *c++ = 0x87; c = grci_emit_disp(c, a);
+            }
+            switch (type) {
+            case GRCI_NT_NAND:
+            case GRCI_NT_AND:
+                *c++ = 0x22; *c++ = 0x87; c = grci_emit_disp(c, b);
+                break;
+            case GRCI_NT_OR:
+                *c++ = 0x0a; *c++ = 0x87; c = grci_emit_disp(c, b);
+                break;
+            case GRCI_NT_XOR:
+            case GRCI_NT_XNOR:
+                *c++ = 0x32; *c++ = 0x87; c = grci_emit_disp(c, b);
+                break;
+            case GRCI_NT_MUX:
+                *c++ = 0x0f; *c++ = 0xb6; *c++ = 0x8f; c = grci_emit_disp(c, b); //movzx ecx, byte [rdi + b]
+                *c++ = 0x31; *c++ = 0xc1;                                          //xor ecx, eax
+                *c++ = 0x22; *c++ = 0x8f; c = grci_emit_disp(c, op[4]);           //and cl, byte [rdi + sel]
+                *c++ = 0x31; *c++ = 0xc8;                                          //xor eax, ecx
+                break;
+            default:
+                break;
+            }
+            if (type == GRCI_NT_NAND || type == GRCI_NT_NOT || type == GRCI_NT_XNOR) {
+                *c++ = 0x34; *c++ = 0x01;
+            }
+            *c++ = 0x88; *c++ = 0x87; c = grci_emit_disp(c, node);
+            in_al = node;
+        }
+        *c++ = 0xc3;
+    }
+
+    grci_ensure(mprotect(jit->code, jit->code_size, PROT_READ | PROT_EXEC) == 0, GRCI_ERR_MEM, 0, "mprotect failed");
+    return GRCI_OK;
+}
+#endif
+
+static inline void grci_jit_eval_op(unsigned char *v, const int *op) {
+    if (op[5] > 1) {
+        //lanes are bytes holding 0 or 1, so 64 bit logic works on all of them at once
+        const uint64_t ones = 0x0101010101010101ull;
+        uint64_t x[3] = { 0, 0, 0 };
+        for (int k = 0; k < grci_gate_operand_count(op[0]); k++) {
+            if ((op[6] >> k) & 1) {
+                x[k] = v[op[2 + k]] * ones;
+            } else if (op[5] == 8) {
+                memcpy(&x[k], &v[op[2 + k]], 8);
+            } else {
+                uint32_t low;
+                memcpy(&low, &v[op[2 + k]], 4);
+                x[k] = low;
+            }
+        }
+        uint64_t r;
+        switch (op[0]) {
+        case GRCI_NT_NAND: r = (x[0] & x[1]) ^ ones; break;
+        case GRCI_NT_NOT:  r = x[0] ^ ones; break;
+        case GRCI_NT_AND:  r = x[0] & x[1]; break;
+        case GRCI_NT_OR:   r = x[0] | x[1]; break;
+        case GRCI_NT_XOR:  r = x[0] ^ x[1]; break;
+        case GRCI_NT_XNOR: r = x[0] ^ x[1] ^ ones; break;
+        default:           r = x[0] ^ ((x[0] ^ x[1]) & x[2]); break;
+        }
+        if (op[5] == 8) {
+            memcpy(&v[op[1]], &r, 8);
+        } else {
+            uint32_t low = (uint32_t) r;
+            memcpy(&v[op[1]], &low, 4);
+        }
+    } else if (op[0] == GRCI_NT_NAND) {
+        v[op[1]] = !(v[op[2]] & v[op[3]]);
+    } else {
+        v[op[1]] = grci_gate_value(op[0], v[op[2]], v[op[3]], v[op[4]]);
+    }
+}
+
+static inline void grci_jit_touch(struct grci_jit *jit, int node) {
+    for (int f = jit->fanout_start[node]; f < jit->fanout_start[node + 1]; f++) {
+        jit->dirty[jit->fanout[f]] = 1;
+    }
+}
+
+//every write to a node outside the ops goes through here so the event driven engine sees it
+static inline void grci_jit_set(struct grci_jit *jit, int node, unsigned char value) {
+    if (jit->values[node] == value) return;
+    jit->values[node] = value;
+    if (jit->dirty) {
+        grci_jit_touch(jit, node);
+    }
+}
+
+static void grci_jit_run_segment(struct grci_jit *jit, const struct grci_jit_segment *seg) {
+    unsigned char *v = jit->values;
+#if defined(GRCI_JIT_X86_64)
+    if (jit->code) {
+        union {
+            void *ptr;
+            void (*run)(unsigned char*);
+        } fn = { .ptr = jit->code + seg->code_off };
+        fn.run(v);
+        return;
+    }
+#endif
+    const int *end = &jit->ops[seg->op_end * GRCI_JIT_OP_SIZE];
+    if (!jit->dirty) {
+        for (const int *op = &jit->ops[seg->op_start * GRCI_JIT_OP_SIZE]; op < end; op += GRCI_JIT_OP_SIZE) {
+            grci_jit_eval_op(v, op);
+        }
+        return;
+    }
+
+    //users of a node are always later in the schedule, so one pass in order settles everything
+    for (int i = seg->op_start; i < seg->op_end; i++) {
+        if (!jit->dirty[i]) continue;
+        jit->dirty[i] = 0;
+        jit->evaluated++;
+        const int *op = &jit->ops[i * GRCI_JIT_OP_SIZE];
+        unsigned char old[8];
+        memcpy(old, &v[op[1]], op[5]);
+        grci_jit_eval_op(v, op);
+        for (int l = 0; l < op[5]; l++) {
+            if (v[op[1] + l] != old[l]) {
+                grci_jit_touch(jit, op[1] + l);
+            }
+        }
+    }
+}
+
+//one pass over the schedule.  Rams write first when write is set, the way the dff phase of grci_eval_dff does
+static void grci_jit_phase(struct grci_simulator *sim, struct grci_jit *jit, bool write) {
+    unsigned char *v = jit->values;
+    for (int s = 0; s < jit->segment_count; s++) {
+        const struct grci_jit_segment *seg = &jit->segments[s];
+        grci_jit_run_segment(jit, seg);
+
+        for (int i = seg->ram_start; i < seg->ram_end; i++) {
+            struct grci_ram64k *ram = &sim->rams[jit->ram_order[i]];
+            int addr = 0;
+            for (int k = 0; k < 16; k++) {
+                addr |= v[ram->addrs[k] - sim->nodes] << k;
+            }
+            if (write && v[ram->load - sim->nodes]) {
+                unsigned char low = 0;
+                unsigned char high = 0;
+                for (int k = 0; k < 8; k++) {
+                    low |= v[ram->inputs[k] - sim->nodes] << k;
+                    high |= v[ram->inputs[k + 8] - sim->nodes] << k;
+                }
+                grci_ram_write_byte(ram, addr, low);
+                grci_ram_write_byte(ram, (addr + 1) % GRCI_RAM64K_SIZE, high);
+            }
+            int word = grci_ram_read_word(ram, addr);
+            for (int k = 0; k < 16; k++) {
+                grci_jit_set(jit, (int) (ram->outputs[k] - sim->nodes), (word >> k) & 1);
+            }
+        }
+    }
+}
+
+//Same results as the recursive evaluation in grci_step_module: on a high clock every dff takes the
+//value of its input computed from the old state, then the outputs are computed from the new state
+static void grci_jit_step(struct grci_module *m) {
+    struct grci_simulator *sim = &m->sim->sim;
+    struct grci_jit *jit = m->sim->jit;
+    unsigned char *v = jit->values;
+
+    for (int i = 0; i < m->sim->module.desc->input_count; i++) {
+        struct grci_node *input = m->sim->module.inputs[i];
+        grci_jit_set(jit, (int) (input - sim->nodes), input->as.constant);
+    }
+    grci_jit_set(jit, (int) (sim->clock - sim->nodes), sim->clock->as.constant);
+    for (int k = 0; k < sim->dff_node_count; k++) {
+        struct grci_node *node = sim->dff_nodes[k];
+        if (node->type == GRCI_NT_DFF) {
+            grci_jit_set(jit, (int) (node - sim->nodes), node->as.dff.last_state);
+        }
+    }
+
+    if (sim->clock->as.constant) {
+        grci_jit_phase(sim, jit, true);
+        for (int k = 0; k < sim->dff_node_count; k++) {
+            struct grci_node *node = sim->dff_nodes[k];
+            if (node->type == GRCI_NT_DFF) {
+                node->cached_state = v[node->as.dff.input - sim->nodes];
+            } else {
+                node->cached_state = v[node - sim->nodes];
+            }
+        }
+        for (int k = 0; k < sim->dff_node_count; k++) {
+            struct grci_node *node = sim->dff_nodes[k];
+            node->as.dff.last_state = node->cached_state;
+            if (node->type == GRCI_NT_DFF) {
+                grci_jit_set(jit, (int) (node - sim->nodes), node->cached_state);
+            }
+        }
+    }
+
+    grci_jit_phase(sim, jit, false);
+    for (int k = 0; k < m->sim->module.desc->output_count; k++) {
+        m->outputs[k] = v[m->sim->module.outputs[k] - sim->nodes];
+    }
+
+    //ram outputs keep the value they read, and everything else only matters to activity recording
+    if (sim->toggle_counts) {
+        for (int i = 0; i < sim->node_count; i++) {
+            sim->nodes[i].cached_state = v[i];
+        }
+    } else {
+        for (int r = 0; r < sim->ram_count; r++) {
+            for (int k = 0; k < 16; k++) {
+                sim->rams[r].outputs[k]->cached_state = v[sim->rams[r].outputs[k] - sim->nodes];
+            }
+        }
+    }
+}
+
+//counts the ops reading each node into fanout_start, or with fill set, lists them in fanout
+static void grci_jit_fanout_pass(struct grci_jit *jit, int *fill) {
+    for (int i = 0; i < jit->op_count; i++) {
+        const int *op = &jit->ops[i * GRCI_JIT_OP_SIZE];
+        for (int k = 0; k < grci_gate_operand_count(op[0]); k++) {
+            int lanes = (op[6] >> k) & 1 ? 1 : op[5];
+            for (int l = 0; l < lanes; l++) {
+                int node = op[2 + k] + l;
+                if (fill) {
+                    jit->fanout[fill[node]++] = i;
+                } else {
+                    jit->fanout_start[node + 1]++;
+                }
+            }
+        }
+    }
+}
+
+static grci_status grci_jit_fanout(struct grci_simulator *sim, struct grci_jit *jit) {
+    int n = sim->node_count;
+    jit->fanout_start = sim->arena.malloc(sizeof(int) * (n + 1));
+    jit->dirty = sim->arena.malloc(jit->op_count + 1);
+    grci_ensure(jit->fanout_start && jit->dirty, GRCI_ERR_MEM, 0, "malloc failed");
+    memset(jit->fanout_start, 0, sizeof(int) * (n + 1));
+    //everything is evaluated on the first step
+    memset(jit->dirty, 1, jit->op_count + 1);
+
+    grci_jit_fanout_pass(jit, NULL);
+    for (int i = 0; i < n; i++) {
+        jit->fanout_start[i + 1] += jit->fanout_start[i];
+    }
+    int *fill = sim->arena.malloc(sizeof(int) * (n + 1));
+    jit->fanout = sim->arena.malloc(sizeof(int) * (jit->fanout_start[n] + 1));
+    if (!fill || !jit->fanout) {
+        sim->arena.free(fill);
+        grci_ensure(false, GRCI_ERR_MEM, 0, "malloc failed");
+    }
+    memcpy(fill, jit->fanout_start, sizeof(int) * n);
+    grci_jit_fanout_pass(jit, fill);
+    sim->arena.free(fill);
+    return GRCI_OK;
+}
+
+//engine is levelized, event or compiled.  Compiled is the levelized schedule turned into machine code,
+//and runs as levelized where there is no code generator
+static grci_status grci_jit_build(struct grci_sim *s, enum grci_engine engine) {
+    struct grci_simulator *sim = &s->sim;
+    grci_ensure(sim->foreign_count == 0, GRCI_ERR_SIM, 0, "modules with foreign parts need the interpreter");
+    struct grci_jit *jit = sim->arena.malloc(sizeof(struct grci_jit));
+    grci_ensure(jit, GRCI_ERR_MEM, 0, "malloc failed");
+    memset(jit, 0, sizeof(struct grci_jit));
+    jit->engine = engine;
+
+    jit->values = sim->arena.malloc(sim->node_count);
+    bool ok = jit->values && grci_jit_schedule(sim, jit);
+    if (engine == GRCI_ENGINE_EVENT) {
+        ok = ok && grci_jit_fanout(sim, jit);
+    }
+#if defined(GRCI_JIT_X86_64)
+    if (engine == GRCI_ENGINE_COMPILED) {
+        ok = ok && grci_jit_emit(jit);
+    }
+#endif
+    if (!ok) {
+        grci_jit_free(sim, jit);
+        return GRCI_ERR;
+    }
+
+    for (int i = 0; i < sim->node_count; i++) {
+        jit->values[i] = sim->nodes[i].type == GRCI_NT_CONSTANT ? sim->nodes[i].as.constant : sim->nodes[i].cached_state;
+    }
+    s->jit = jit;
+    return GRCI_OK;
+}
+
+//the schedule and generated code address nodes by index, so they are rebuilt after nodes move
+static grci_status grci_jit_rebuild(struct grci_sim *s) {
+    enum grci_engine engine = s->jit->engine;
+    grci_jit_free(&s->sim, s->jit);
+    s->jit = NULL;
+    return grci_jit_build(s, engine);
+}
+
+//Switches the module between the recursive evaluator and compiled levelized evaluation.  Fails, and
+//leaves the recursive evaluator in place, if the design has combinational loops
+grci_status grci_set_jit(struct grci_module *m, bool enabled) {
+    return grci_set_engine(m, enabled ? GRCI_ENGINE_COMPILED : GRCI_ENGINE_RECURSIVE);
+}
+
+//Unit delay simulation.  A gate shows a change of its inputs at its output delay time units later, and
+//every change is kept (transport delay) so pulses shorter than a gate delay still show up as glitches.
+//Pending changes sit on a timing wheel: bucket t % wheel_size holds the changes due at time t, and all
+//delays are shorter than the wheel, so a bucket never mixes two times and only switching gates cost anything
+struct grci_timing_event {
+    int node;
+    unsigned char value;
+};
+
+struct grci_timing_bucket {
+    struct grci_timing_event *events;
+    int count;
+    int cap;
+};
+
+struct grci_timing_sim {
+    struct grci_arena arena;
+    unsigned char *values;
+    unsigned char *projected; //value once every pending change has happened
+    int (*operands)[3];
+    int *fanout_start; //gates, and rams as -(ram index) - 1, reading each node
+    int *fanout;
+    unsigned short *delays;
+    uint64_t *evaluated; //stamp of the last time each gate was evaluated, so it's only done once per time
+    uint64_t stamp;
+
+    struct grci_timing_bucket *wheel;
+    int wheel_size; //power of two
+    int pending;
+
+    int *changed; //nodes changed at the current time
+    int changed_count;
+    int *evals;
+    bool *ram_marked;
+    int *rams;
+    int ram_count;
+    unsigned char *toggles; //changes per node this step, saturating
+    int *toggled;
+    int toggled_count;
+
+    bool resettle; //values can't be trusted, so every gate is evaluated on the next step
+    struct grci_timing report;
+};
+
+static void grci_timing_free(struct grci_simulator *sim, struct grci_timing_sim *t) {
+    if (!t) return;
+    for (int i = 0; i < t->wheel_size; i++) {
+        sim->arena.free(t->wheel[i].events);
+    }
+    sim->arena.free(t->wheel);
+    grci_arena_cleanup(&t->arena);
+    sim->arena.free(t);
+}
+
+static grci_status grci_timing_wheel(struct grci_simulator *sim, struct grci_timing_sim *t, int max_delay) {
+    int size = 2;
+    while (size <= max_delay) {
+        size *= 2;
+    }
+    if (size <= t->wheel_size) return GRCI_OK;
+    struct grci_timing_bucket *wheel = sim->arena.realloc(t->wheel, sizeof(struct grci_timing_bucket) * size);
+    grci_ensure(wheel, GRCI_ERR_MEM, 0, "realloc failed");
+    memset(wheel + t->wheel_size, 0, sizeof(struct grci_timing_bucket) * (size - t->wheel_size));
+    t->wheel = wheel;
+    t->wheel_size = size;
+    return GRCI_OK;
+}
+
+static inline grci_status grci_timing_schedule(struct grci_simulator *sim, struct grci_timing_sim *t, uint64_t when, int node, unsigned char value) {
+    struct grci_timing_bucket *b = &t->wheel[when & (t->wheel_size - 1)];
+    if (b->count == b->cap) {
+        int cap = b->cap ? b->cap * 2 : 16;
+        struct grci_timing_event *events = sim->arena.realloc(b->events, sizeof(struct grci_timing_event) * cap);
+        grci_ensure(events, GRCI_ERR_MEM, 0, "realloc failed");
+        b->events = events;
+        b->cap = cap;
+    }
+    b->events[b->count++] = (struct grci_timing_event) { .node = node, .value = value };
+    t->projected[node] = value;
+    t->pending++;
+    return GRCI_OK;
+}
+
+//a node set from outside the gates, at the start of a settle
+static inline void grci_timing_set(struct grci_timing_sim *t, int node, unsigned char value) {
+    if (t->values[node] == value) return;
+    t->values[node] = value;
+    t->projected[node] = value;
+    t->changed[t->changed_count++] = node;
+}
+
+static inline void grci_timing_mark_ram(struct grci_timing_sim *t, int r) {
+    if (t->ram_marked[r]) return;
+    t->ram_marked[r] = true;
+    t->rams[t->ram_count++] = r;
+}
+
+static inline unsigned char grci_timing_eval(const struct grci_simulator *sim, const struct grci_timing_sim *t, int g) {
+    const int *in = t->operands[g];
+    if (sim->nodes[g].type == GRCI_NT_NAND) {
+        return !(t->values[in[0]] & t->values[in[1]]);
+    }
+    return grci_gate_value(sim->nodes[g].type, t->values[in[0]], t->values[in[1]], t->values[in[2]]);
+}
+
+static inline int grci_timing_addr(const struct grci_simulator *sim, const struct grci_timing_sim *t, const struct grci_ram64k *ram) {
+    int addr = 0;
+    for (int k = 0; k < 16; k++) {
+        addr |= t->values[ram->addrs[k] - sim->nodes] << k;
+    }
+    return addr;
+}
+
+//Runs the wheel from the changes already in t->changed until nothing is pending.  Returns the time of the
+//last transition
+static uint64_t grci_timing_settle(struct grci_simulator *sim, struct grci_timing_sim *t) {
+    uint64_t now = 0;
+    uint64_t last = 0;
+    while (true) {
+        //every gate reading something that changed now is evaluated once, with all of now's changes in
+        t->stamp++;
+        int eval_count = 0;
+        for (int i = 0; i < t->changed_count; i++) {
+            int node = t->changed[i];
+            for (int f = t->fanout_start[node]; f < t->fanout_start[node + 1]; f++) {
+                int user = t->fanout[f];
+                if (user < 0) {
+                    grci_timing_mark_ram(t, -user - 1);
+                } else if (t->evaluated[user] != t->stamp) {
+                    t->evaluated[user] = t->stamp;
+                    t->evals[eval_count++] = user;
+                }
+            }
+        }
+        t->changed_count = 0;
+        for (int i = 0; i < eval_count; i++) {
+            int g = t->evals[i];
+            unsigned char v = grci_timing_eval(sim, t, g);
+            if (v != t->projected[g]) {
+                grci_timing_schedule(sim, t, now + t->delays[g], g, v);
+            }
+        }
+        //a read takes one time unit, like a gate
+        for (int i = 0; i < t->ram_count; i++) {
+            struct grci_ram64k *ram = &sim->rams[t->rams[i]];
+            int word = grci_ram_read_word(ram, grci_timing_addr(sim, t, ram));
+            for (int k = 0; k < 16; k++) {
+                int o = (int) (ram->outputs[k] - sim->nodes);
+                if (((word >> k) & 1) != t->projected[o]) {
+                    grci_timing_schedule(sim, t, now + 1, o, (word >> k) & 1);
+                }
+            }
+            t->ram_marked[t->rams[i]] = false;
+        }
+        t->ram_count = 0;
+
+        if (t->pending == 0) break;
+        do {
+            now++;
+        } while (t->wheel[now & (t->wheel_size - 1)].count == 0);
+        if (now > GRCI_TIMING_MAX_TIME) {
+            //whatever was still on its way is applied at once
+            for (int i = 0; i < t->wheel_size; i++) {
+                t->wheel[i].count = 0;
+            }
+            t->pending = 0;
+            memcpy(t->values, t->projected, sim->node_count);
+            t->report.settled = false;
+            break;
+        }
+
+        struct grci_timing_bucket *b = &t->wheel[now & (t->wheel_size - 1)];
+        for (int i = 0; i < b->count; i++) {
+            struct grci_timing_event e = b->events[i];
+            if (t->values[e.node] == e.value) continue;
+            t->values[e.node] = e.value;
+            t->changed[t->changed_count++] = e.node;
+            if (t->toggles[e.node]++ == 0) {
+                t->toggled[t->toggled_count++] = e.node;
+            } else if (t->toggles[e.node] == 2) {
+                t->report.glitches++;
+            }
+            if (t->toggles[e.node] == 255) {
+                t->toggles[e.node] = 2;
+            }
+            t->report.events++;
+            last = now;
+        }
+        t->pending -= b->count;
+        b->count = 0;
+    }
+    return last;
+}
+
+//Inputs settle first, as if they changed a setup time before the edge.  Then, on a high step, dffs and
+//rams take the settled values and the edge ripples through.  Results match the zero delay engines
+static void grci_timing_step(struct grci_module *m) {
+    struct grci_simulator *sim = &m->sim->sim;
+    struct grci_timing_sim *t = m->sim->timing;
+    t->report = (struct grci_timing) { .settled = true };
+
+    if (t->resettle) {
+        for (int i = 0; i < sim->node_count; i++) {
+            t->changed[t->changed_count++] = i;
+        }
+        t->resettle = false;
+    }
+    for (int i = 0; i < m->sim->module.desc->input_count; i++) {
+        struct grci_node *input = m->sim->module.inputs[i];
+        grci_timing_set(t, (int) (input - sim->nodes), input->as.constant);
+    }
+    grci_timing_set(t, (int) (sim->clock - sim->nodes), sim->clock->as.constant);
+    //dffs and rams can be written by the host between steps
+    for (int k = 0; k < sim->dff_node_count; k++) {
+        struct grci_node *node = sim->dff_nodes[k];
+        if (node->type == GRCI_NT_DFF) {
+            grci_timing_set(t, (int) (node - sim->nodes), node->as.dff.last_state);
+        }
+    }
+    for (int r = 0; r < sim->ram_count; r++) {
+        grci_timing_mark_ram(t, r);
+    }
+    t->report.settle_time = grci_timing_settle(sim, t);
+
+    if (sim->clock->as.constant) {
+        for (int r = 0; r < sim->ram_count; r++) {
+            struct grci_ram64k *ram = &sim->rams[r];
+            if (t->values[ram->load - sim->nodes]) {
+                int addr = grci_timing_addr(sim, t, ram);
+                unsigned char low = 0;
+                unsigned char high = 0;
+                for (int k = 0; k < 8; k++) {
+                    low |= t->values[ram->inputs[k] - sim->nodes] << k;
+                    high |= t->values[ram->inputs[k + 8] - sim->nodes] << k;
+                }
+                grci_ram_write_byte(ram, addr, low);
+                grci_ram_write_byte(ram, (addr + 1) % GRCI_RAM64K_SIZE, high);
+            }
+            grci_timing_mark_ram(t, r);
+        }
+        int changed_count = 0;
+        for (int k = 0; k < sim->dff_node_count; k++) {
+            struct grci_node *node = sim->dff_nodes[k];
+            if (node->type == GRCI_NT_DFF) {
+                node->cached_state = t->values[node->as.dff.input - sim->nodes];
+                node->as.dff.last_state = node->cached_state;
+                //all dffs switch together, so none sees another's new value
+                if (t->values[node - sim->nodes] != node->cached_state) {
+                    t->evals[changed_count++] = (int) (node - sim->nodes);
+                }
+            }
+        }
+        for (int i = 0; i < changed_count; i++) {
+            grci_timing_set(t, t->evals[i], !t->values[t->evals[i]]);
+        }
+        t->report.settle_time = grci_timing_settle(sim, t);
+        for (int k = 0; k < sim->dff_node_count; k++) {
+            struct grci_node *node = sim->dff_nodes[k];
+            if (node->type == GRCI_NT_RAM64KOUT) {
+                node->cached_state = t->values[node - sim->nodes];
+                node->as.dff.last_state = node->cached_state;
+            }
+        }
+    }
+
+    for (int k = 0; k < m->sim->module.desc->output_count; k++) {
+        m->outputs[k] = t->values[m->sim->module.outputs[k] - sim->nodes];
+    }
+    if (sim->toggle_counts) {
+        for (int i = 0; i < sim->node_count; i++) {
+            sim->nodes[i].cached_state = t->values[i];
+        }
+    }
+    for (int i = 0; i < t->toggled_count; i++) {
+        t->toggles[t->toggled[i]] = 0;
+    }
+    t->toggled_count = 0;
+}
+
+static grci_status grci_timing_build(struct grci_sim *s) {
+    struct grci_simulator *sim = &s->sim;
+    int n = sim->node_count;
+    grci_ensure(sim->foreign_count == 0, GRCI_ERR_SIM, 0, "modules with foreign parts need the interpreter");
+    grci_ensure(!sim->fused, GRCI_ERR_SIM, 0, "timing needs every nand, and this module has fused gates");
+
+    struct grci_timing_sim *t = sim->arena.malloc(sizeof(struct grci_timing_sim));
+    grci_ensure(t, GRCI_ERR_MEM, 0, "malloc failed");
+    memset(t, 0, sizeof(struct grci_timing_sim));
+    if (!grci_arena_init(&t->arena, sim->arena.malloc, sim->arena.realloc, sim->arena.free)) {
+        sim->arena.free(t);
+        return GRCI_ERR;
+    }
+    struct grci_arena *a = &t->arena;
+    bool ok = grci_arena_malloc(a, n, (void**) &t->values) &&
+              grci_arena_malloc(a, n, (void**) &t->projected) &&
+              grci_arena_calloc(a, n, sizeof(int[3]), (void**) &t->operands) &&
+              grci_arena_calloc(a, n + 1, sizeof(int), (void**) &t->fanout_start) &&
+              grci_arena_calloc(a, n, sizeof(unsigned short), (void**) &t->delays) &&
+              grci_arena_calloc(a, n, sizeof(uint64_t), (void**) &t->evaluated) &&
+              grci_arena_malloc(a, sizeof(int) * n, (void**) &t->changed) &&
+              grci_arena_malloc(a, sizeof(int) * n, (void**) &t->evals) &&
+              grci_arena_calloc(a, sim->ram_count + 1, sizeof(bool), (void**) &t->ram_marked) &&
+              grci_arena_malloc(a, sizeof(int) * (sim->ram_count + 1), (void**) &t->rams) &&
+              grci_arena_calloc(a, n, 1, (void**) &t->toggles) &&
+              grci_arena_malloc(a, sizeof(int) * n, (void**) &t->toggled) &&
+              grci_timing_wheel(sim, t, 1);
+
+    //users of each node, counted and then filled in the same order
+    int *fill = NULL;
+    for (int pass = 0; ok && pass < 2; pass++) {
+        for (int i = 0; i < n; i++) {
+            struct grci_node **slots[3];
+            int operand_count = grci_node_operands(&sim->nodes[i], slots);
+            for (int k = 0; k < operand_count; k++) {
+                int from = (int) (*slots[k] - sim->nodes);
+                if (pass == 0) {
+                    t->fanout_start[from + 1]++;
+                } else {
+                    t->fanout[fill[from]++] = i;
+                }
+            }
+            for (int k = 0; k < 3; k++) {
+                t->operands[i][k] = operand_count > 0 ? (int) (*slots[k < operand_count ? k : 0] - sim->nodes) : 0;
+            }
+            t->delays[i] = operand_count > 0 ? 1 : 0;
+        }
+        for (int r = 0; r < sim->ram_count; r++) {
+            for (int k = 0; k < 16; k++) {
+                int from = (int) (sim->rams[r].addrs[k] - sim->nodes);
+                if (pass == 0) {
+                    t->fanout_start[from + 1]++;
+                } else {
+                    t->fanout[fill[from]++] = -r - 1;
+                }
+            }
+        }
+        if (pass == 0) {
+            for (int i = 0; i < n; i++) {
+                t->fanout_start[i + 1] += t->fanout_start[i];
+            }
+            ok = grci_arena_malloc(a, sizeof(int) * (t->fanout_start[n] + 1), (void**) &t->fanout) &&
+                 grci_arena_malloc(a, sizeof(int) * (n + 1), (void**) &fill);
+            if (ok) {
+                memcpy(fill, t->fanout_start, sizeof(int) * n);
+            }
+        }
+    }
+    if (!ok) {
+        grci_timing_free(sim, t);
+        grci_ensure(false, GRCI_ERR_MEM, 0, "placeholder");
+    }
+
+    for (int i = 0; i < n; i++) {
+        struct grci_node *node = &sim->nodes[i];
+        t->values[i] = node->type == GRCI_NT_CONSTANT ? node->as.constant : node->type == GRCI_NT_DFF ? node->as.dff.last_state : node->cached_state;
+    }
+    memcpy(t->projected, t->values, n);
+    t->resettle = true;
+    t->report.settled = true;
+    s->timing = t;
+    return GRCI_OK;
+}
+
+//Sets the delay of every gate in a top level part, or in the whole module if submodule_name is NULL.
+//Only for the timing engine, where gates start out with a delay of 1
+grci_status grci_set_delay(struct grci_module *m, const char *submodule_name, size_t len, int delay) {
+    struct grci_simulator *sim = &m->sim->sim;
+    struct grci_timing_sim *t = m->sim->timing;
+    grci_ensure(t, GRCI_ERR_SIM, 0, "delays need the timing engine");
+    grci_ensure(delay >= 1 && delay <= GRCI_TIMING_MAX_DELAY, GRCI_ERR_SIM, 0, "delays go from 1 to %d", GRCI_TIMING_MAX_DELAY);
+    grci_ensure(grci_timing_wheel(sim, t, delay), GRCI_ERR_MEM, 0, "placeholder");
+
+    int off = 0;
+    int count = sim->node_count;
+    if (submodule_name) {
+        grci_ensure(grci_part_node_range(m->sim->module.desc, submodule_name, len, &off, &count, NULL),
+                    GRCI_ERR_SIM, 0, "placeholder");
+    }
+    for (int j = off; j < off + count; j++) {
+        int i = submodule_name ? grci_node_pos(sim, j) : j;
+        if (i >= 0 && t->delays[i] > 0) {
+            t->delays[i] = (unsigned short) delay;
+        }
+    }
+    return GRCI_OK;
+}
+
+//what the last step of the timing engine saw
+grci_status grci_get_timing(struct grci_module *m, struct grci_timing *timing) {
+    grci_ensure(m->sim->timing, GRCI_ERR_SIM, 0, "timing needs the timing engine");
+    *timing = m->sim->timing->report;
+    return GRCI_OK;
+}
+
+static inline uint64_t grci_splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+//Steps a copy of the design on the event driven engine for a fixed number of cycles, with inputs from a
+//fixed seed changing every 8 cycles, and returns the percentage of gates evaluated per step.  Counting
+//work rather than timing it gives the same answer on every run.  -1 if there's no copy to step
+static int grci_engine_warmup(struct grci_sim *s) {
+    struct grci *g = s->g;
+    const struct grci_module_desc *desc = s->module.desc;
+    //imported netlists have no description to instantiate a copy from
+    struct grci_module *scratch = grci_pool_index(g, desc) != -1 ? grci_init_module(g, desc->name.ptr, desc->name.len) : NULL;
+    if (!scratch) return -1;
+    scratch->sim->step_limit = 0;
+    if ((s->sim.fused && !grci_fuse_gates(scratch)) || !grci_set_engine(scratch, GRCI_ENGINE_EVENT)) {
+        grci_destroy_module(scratch);
+        return -1;
+    }
+
+    //the first cycle evaluates everything, so it isn't counted
+    grci_step_cycle(scratch);
+    struct grci_jit *jit = scratch->sim->jit;
+    jit->evaluated = 0;
+    uint64_t seed = 1;
+    for (int c = 0; c < GRCI_AUTO_WARMUP_CYCLES; c++) {
+        if (c % 8 == 0) {
+            uint64_t bits = grci_splitmix64(&seed);
+            for (int i = 0; i < scratch->input_count; i++) {
+                scratch->inputs[i] = (bits >> (i % 64)) & 1;
+            }
+        }
+        grci_step_cycle(scratch);
+    }
+    uint64_t ops = (uint64_t) (jit->op_count > 0 ? jit->op_count : 1) * 2 * GRCI_AUTO_WARMUP_CYCLES;
+    int percent = (int) (jit->evaluated * 100 / ops);
+    grci_destroy_module(scratch);
+    return percent;
+}
+
+//Rules out scheduling from what the description says, then picks the event driven engine if little of the
+//design changes from step to step in the warm-up, and the fastest levelized one this build has otherwise
+static grci_status grci_engine_auto(struct grci_module *m) {
+    struct grci_sim *s = m->sim;
+    char *reason = s->engine_reason;
+    size_t reason_size = sizeof(s->engine_reason);
+
+    if (s->sim.foreign_count > 0) {
+        snprintf(reason, reason_size, "%d foreign parts need the recursive interpreter", s->sim.foreign_count);
+        return GRCI_OK;
+    }
+    if (s->sim.node_count < GRCI_AUTO_MIN_NODES) {
+        snprintf(reason, reason_size, "%d nodes are too few to be worth scheduling", s->sim.node_count);
+        return GRCI_OK;
+    }
+    if (!grci_jit_build(s, GRCI_ENGINE_LEVELIZED)) {
+        //the failed schedule isn't an error of this call
+        grci_err_buf[0] = '\0';
+        snprintf(reason, reason_size, "combinational loops can't be levelized");
+        return GRCI_OK;
+    }
+    grci_jit_free(&s->sim, s->jit);
+    s->jit = NULL;
+
+#if defined(GRCI_JIT_X86_64)
+    enum grci_engine levelized = GRCI_ENGINE_COMPILED;
+#else
+    enum grci_engine levelized = GRCI_ENGINE_LEVELIZED;
+#endif
+    int percent = grci_engine_warmup(s);
+    if (percent < 0) {
+        grci_err_buf[0] = '\0';
+        snprintf(reason, reason_size, "%d nodes with no combinational loops, not measured", s->sim.node_count);
+        return grci_jit_build(s, levelized);
+    }
+    enum grci_engine best = percent < GRCI_AUTO_EVENT_PERCENT ? GRCI_ENGINE_EVENT : levelized;
+    snprintf(reason, reason_size, "%d nodes, %d dffs%s, %d%% of gates evaluated per step in warm-up", s->sim.node_count,
+             s->sim.dff_node_count, s->sim.ram_count > 0 ? " and rams" : "", percent);
+    return grci_jit_build(s, best);
+}
+
+//Picks how grci_step_module evaluates the design.  The state carries over, and on failure the module is
+//left on the recursive interpreter
+grci_status grci_set_engine(struct grci_module *m, enum grci_engine engine) {
+    struct grci_sim *s = m->sim;
+    grci_jit_free(&s->sim, s->jit);
+    s->jit = NULL;
+    grci_timing_free(&s->sim, s->timing);
+    s->timing = NULL;
+    snprintf(s->engine_reason, sizeof(s->engine_reason), "set by the host");
+    switch (engine) {
+    case GRCI_ENGINE_AUTO:
+        return grci_engine_auto(m);
+    case GRCI_ENGINE_RECURSIVE:
+        return GRCI_OK;
+    case GRCI_ENGINE_LEVELIZED:
+    case GRCI_ENGINE_EVENT:
+    case GRCI_ENGINE_COMPILED:
+        return grci_jit_build(s, engine);
+    case GRCI_ENGINE_TIMING:
+        return grci_timing_build(s);
+    }
+    grci_ensure(false, GRCI_ERR_SIM, 0, "unknown engine %d", (int) engine);
+    return GRCI_OK;
+}
+
+//reason is why the engine was picked, valid until the engine changes
+enum grci_engine grci_get_engine(struct grci_module *m, const char **reason) {
+    struct grci_sim *s = m->sim;
+    if (reason) {
+        *reason = s->engine_reason[0] ? s->engine_reason : "default";
+    }
+    if (s->timing) return GRCI_ENGINE_TIMING;
+    return s->jit ? s->jit->engine : GRCI_ENGINE_RECURSIVE;
+}
+
+//Packs the outputs, then the states of each captured submodule, into the next record of the ring
+static void grci_capture_record(struct grci_sim *s, const bool *outputs) {
+    struct grci_capture *c = s->capture;
+    uint64_t *record = c->buffer + (size_t) (c->written % c->record_count) * c->record_words;
+    memset(record, 0, sizeof(uint64_t) * c->record_words);
+
+    int bit = 0;
+    for (int i = 0; i < s->module.desc->output_count; i++, bit++) {
+        record[bit / 64] |= (uint64_t) outputs[i] << (bit % 64);
+    }
+    for (int p = 0; p < c->state_count; p++) {
+        int dff_off = s->module.dff_off_len[s->capture_parts[p]][0];
+        int dff_len = s->module.dff_off_len[s->capture_parts[p]][1];
+        for (int j = 0; j < dff_len; j++, bit++) {
+            record[bit / 64] |= (uint64_t) s->sim.dff_nodes[j + dff_off]->as.dff.last_state << (bit % 64);
+        }
+    }
+    c->written++;
+}
+
+//Records are written every capture->interval steps until capture is replaced or NULL is passed.
+//Ram64K submodules can't be captured, grci_ram_dump is the way to read those
+grci_status grci_set_capture(struct grci_module *m, struct grci_capture *capture) {
+    struct grci_sim *s = m->sim;
+    s->sim.arena.free(s->capture_parts);
+    s->capture_parts = NULL;
+    s->capture = NULL;
+    if (!capture) return GRCI_OK;
+
+    grci_ensure(capture->interval > 0, GRCI_ERR_SIM, 0, "capture interval must be positive");
+    s->capture_parts = s->sim.arena.malloc(sizeof(int) * (capture->state_count + 1));
+    grci_ensure(s->capture_parts, GRCI_ERR_MEM, 0, "malloc failed");
+
+    const struct grci_module_desc *desc = s->module.desc;
+    int bits = desc->output_count;
+    for (int p = 0; p < capture->state_count; p++) {
+        const char *name = capture->states[p];
+        int part_idx = -1;
+        for (int i = 0; i < desc->part_count && part_idx == -1; i++) {
+            if (desc->part_names[i].ptr && grci_string_matches(&desc->part_names[i], name, strlen(name))) {
+                part_idx = i;
+            }
+        }
+        bool ok = part_idx != -1 && !grci_string_matches(&desc->parts[part_idx]->name, "Ram64K", 6);
+        if (!ok) {
+            grci_set_capture(m, NULL);
+            grci_ensure(false, GRCI_ERR_SIM, 0, "submodule %s does not exist or is a Ram64K", name);
+        }
+        s->capture_parts[p] = part_idx;
+        bits += s->module.dff_off_len[part_idx][1];
+    }
+
+    capture->record_words = (bits + 63) / 64;
+    capture->record_count = capture->word_count / (capture->record_words > 0 ? capture->record_words : 1);
+    capture->written = 0;
+    if (capture->record_words == 0 || capture->record_count == 0) {
+        grci_set_capture(m, NULL);
+        grci_ensure(false, GRCI_ERR_SIM, 0, "capture buffer needs room for at least one record");
+    }
+    s->capture = capture;
+    return GRCI_OK;
+}
+
+//A quiet step leaves the outputs as they were.  Only low steps are ever quiet since nothing but the outputs
+//changes on them, and not while recording activity or when the step is captured
+static grci_status grci_step_allowed(struct grci_sim *s) {
+    grci_ensure(s->step_limit == 0 || s->step_count < s->step_limit, GRCI_ERR_SIM, 0, 
+                "module reached its limit of %llu cycles", (unsigned long long) (s->step_limit / 2));
+    return GRCI_OK;
+}
+
+static bool grci_step(struct grci_module *m, bool quiet) {
+    if (!grci_step_allowed(m->sim)) {
+        return m->sim->sim.clock->as.constant;
+    }
+    struct grci_checkpoints *cp = &m->sim->checkpoints;
+    if (m->sim->journal.words) {
+        grci_journal_begin(m->sim, m->outputs);
+    }
+
+    //set module inputs
+    for (int i = 0; i < m->sim->module.desc->input_count; i++) {
+        m->sim->module.inputs[i]->as.constant = m->inputs[i];
+    }
+
+    //set submodule states
+    bool host_write = grci_sync_states_in(m->sim) || cp->host_write;
+
+    //state written by the host isn't in the input history, so it's captured in a checkpoint
+    //before stepping.  If recording fails, checkpoints are dropped rather than left unable to replay
+    if (cp->interval > 0) {
+        bool ok = grci_record_inputs(m->sim, m->inputs);
+        if (ok && host_write) {
+            ok = grci_checkpoint_take(m->sim, m->outputs);
+        }
+        if (!ok) {
+            grci_checkpoints_clear(m->sim);
+        }
+        cp->host_write = false;
+    }
+
+    struct grci_simulator *sim = &m->sim->sim;
+
+    sim->clock->as.constant = sim->clock->as.constant == 0 ? 1: 0;
+
+    struct grci_capture *capture = m->sim->capture;
+    quiet = quiet && !sim->clock->as.constant && !sim->toggle_counts && !m->sim->timing &&
+            !(capture && (m->sim->step_count + 1) % capture->interval == 0);
+
+    if (quiet) {
+        //dffs only change on the rising edge, so there's nothing to evaluate
+    } else if (m->sim->timing) {
+        grci_timing_step(m);
+    } else if (m->sim->jit) {
+        grci_jit_step(m);
+    } else {
+        //not reseting nodes recursively since that's too slow
+        for (int k = 0; k < sim->node_count; k++) {
+            sim->nodes[k].visited = false;
+        }
+
+        //updating all flip flops first prevents bug with combinationals gates getting old data when evaluated first
+        if (sim->clock->as.constant) {
+            for (int k = 0; k < sim->dff_node_count; k++) {
+                sim->dff_nodes[k]->visited = false;
+                grci_eval_dff(sim->dff_nodes[k], true);
+
+                for (int k = 0; k < sim->node_count; k++) {
+                    if (sim->nodes[k].type != GRCI_NT_DFF)
+                        sim->nodes[k].visited = false;
+                }
+            }
+
+            //foreign modules latch on the same edge, seeing the same pre-edge inputs as the flip flops
+            for (int k = 0; k < sim->foreign_count; k++) {
+                struct grci_foreign_instance *f = &sim->foreigns[k];
+                grci_eval_foreign(f, true);
+                if (f->desc->foreign->clock) {
+                    f->desc->foreign->clock(f->state, f->in_values, f->desc->foreign->user);
+                    f->dirty = true;
+                }
+            }
+            if (sim->foreign_count > 0) {
+                for (int k = 0; k < sim->node_count; k++) {
+                    if (sim->nodes[k].type != GRCI_NT_DFF)
+                        sim->nodes[k].visited = false;
+                }
+            }
+
+            //setting state of flip flops to new value
+            for (int k = 0; k < sim->dff_node_count; k++) {
+                sim->dff_nodes[k]->as.dff.last_state = sim->dff_nodes[k]->cached_state;
+            }
+        }
+
+
+        for (int k = 0; k < m->sim->module.desc->output_count; k++) {
+            bool v = grci_eval_node(m->sim->module.outputs[k]);
+            m->outputs[k] = v;
+        }
+    }
+
+    //set submodule states
+    if (!quiet) {
+        grci_sync_states_out(m->sim);
+    }
+
+    if (sim->toggle_counts) {
+        grci_activity_record(sim);
+    }
+
+    m->sim->step_count++;
+    if (capture && m->sim->step_count % capture->interval == 0) {
+        grci_capture_record(m->sim, m->outputs);
+    }
+    if (m->sim->journal.words) {
+        grci_journal_end(m->sim, m->outputs);
+    }
+    if (cp->interval > 0 && m->sim->step_count % cp->interval == 0) {
+        if (!grci_checkpoint_take(m->sim, m->outputs)) {
+            grci_checkpoints_clear(m->sim);
+        }
+    }
+
+    return sim->clock->as.constant;
+}
+
+bool grci_step_module(struct grci_module *m) {
+    return grci_step(m, false);
+}
+
+//Steps to the next rising or falling edge, taking two steps if the clock is already at that level.
+//Outputs are only evaluated after the last step when the first is a low one
+bool grci_step_edge(struct grci_module *m, bool rising) {
+    if (m->sim->sim.clock->as.constant == rising) {
+        grci_step(m, true);
+    }
+    return grci_step(m, false);
+}
+
+//a low step followed by a high one, with the outputs and submodule states read back after the high step only
+bool grci_step_cycle(struct grci_module *m) {
+    return grci_step_edge(m, true);
+}
+
+//Steps count times with the inputs held, returning the clock like grci_step_module.  Outputs are only
+//guaranteed to be current after the last step
+bool grci_run_module(struct grci_module *m, uint64_t count) {
+    for (uint64_t i = 0; i < count; i++) {
+        grci_step(m, i + 1 < count);
+    }
+    return m->sim->sim.clock->as.constant;
+}
+
+//interval 0 turns checkpointing off.  Steps before the checkpointing was turned on can't be reached, and
+//budget bounds the bytes of checkpoints and input history, with the oldest steps dropped to stay under it
+grci_status grci_set_checkpoints(struct grci_module *m, int interval, size_t budget) {
+    grci_checkpoints_clear(m->sim);
+    if (interval <= 0) return GRCI_OK;
+    //replaying from a checkpoint would start foreign parts from their current state
+    grci_ensure(m->sim->sim.foreign_count == 0, GRCI_ERR_SIM, 0, "modules with foreign parts can't be checkpointed");
+
+    struct grci_checkpoints *cp = &m->sim->checkpoints;
+    cp->interval = interval;
+    cp->budget = budget;
+    cp->input_bytes = (m->sim->module.desc->input_count + 7) / 8;
+    if (cp->input_bytes == 0) {
+        cp->input_bytes = 1;
+    }
+    cp->input_base = m->sim->step_count;
+    cp->input_capacity = 256;
+    cp->used = (size_t) cp->input_capacity * cp->input_bytes;
+    cp->inputs = m->sim->sim.arena.malloc((size_t) cp->input_capacity * cp->input_bytes);
+    if (!cp->inputs) {
+        grci_checkpoints_clear(m->sim);
+        grci_ensure(false, GRCI_ERR_MEM, 0, "malloc failed");
+    }
+
+    if (!grci_checkpoint_take(m->sim, m->outputs)) {
+        grci_checkpoints_clear(m->sim);
+        return GRCI_ERR;
+    }
+    return GRCI_OK;
+}
+
+//Journals at most max_bytes of changes so steps can be undone one at a time with grci_step_back.
+//0 turns the journal off.  A single step with more changes than fit empties the journal
+grci_status grci_set_journal(struct grci_module *m, size_t max_bytes) {
+    struct grci_sim *s = m->sim;
+    grci_journal_clear(s);
+    if (max_bytes == 0) return GRCI_OK;
+    grci_ensure(s->sim.foreign_count == 0, GRCI_ERR_SIM, 0, "modules with foreign parts can't be journaled");
+
+    struct grci_journal *j = &s->journal;
+    j->capacity = max_bytes / sizeof(uint32_t);
+    grci_ensure(j->capacity >= 4, GRCI_ERR_SIM, 0, "journal needs at least %zu bytes", 4 * sizeof(uint32_t));
+    j->words = s->sim.arena.malloc(sizeof(uint32_t) * j->capacity);
+    j->before = s->sim.arena.malloc(sizeof(bool) * (s->sim.dff_node_count * 2 + s->module.desc->output_count + 1));
+    if (!j->words || !j->before) {
+        grci_journal_clear(s);
+        grci_ensure(false, GRCI_ERR_MEM, 0, "malloc failed");
+    }
+    j->rams = s->sim.rams;
+    for (int r = 0; r < s->sim.ram_count; r++) {
+        s->sim.rams[r].journal = j;
+    }
+    grci_journal_reset(j);
+    return GRCI_OK;
+}
+
+//undoes the last step, along with any ram writes the host made after it
+grci_status grci_step_back(struct grci_module *m) {
+    struct grci_sim *s = m->sim;
+    struct grci_journal *j = &s->journal;
+    grci_ensure(j->words, GRCI_ERR_SIM, 0, "journal is not enabled");
+    if (j->overflow) {
+        grci_journal_reset(j);
+    }
+    grci_ensure(j->groups > 0, GRCI_ERR_SIM, 0, "no journaled step to undo");
+
+    //open group, then its header
+    grci_journal_undo(s, m->outputs, j->open - 1);
+    grci_journal_pop(j);
+
+    uint32_t len = grci_journal_pop(j) & ~(3u << 30);
+    grci_journal_undo(s, m->outputs, len);
+    grci_journal_pop(j);
+    j->groups--;
+    grci_journal_open_group(j);
+
+    s->sim.clock->as.constant = !s->sim.clock->as.constant;
+    s->step_count--;
+    grci_sync_states_out(s);
+
+    //checkpoints and inputs recorded after this step are from a history that's being rewritten
+    struct grci_checkpoints *cp = &s->checkpoints;
+    while (cp->count > 0 && cp->entries[cp->count - 1].step > s->step_count) {
+        cp->count--;
+        grci_checkpoint_free(s, &cp->entries[cp->count]);
+    }
+    //back past the oldest checkpoint, the input history starts over from here
+    if (cp->interval > 0 && cp->count == 0 && !grci_set_checkpoints(m, cp->interval, cp->budget)) {
+        grci_checkpoints_clear(s);
+    }
+    return GRCI_OK;
+}
+
+uint64_t grci_step_count(struct grci_module *m) {
+    return m->sim->step_count;
+}
+
+//Restores the closest checkpoint at or before step and replays the recorded inputs from there.
+//Anything recorded after step is discarded, since stepping on from there starts a new history
+grci_status grci_seek_module(struct grci_module *m, uint64_t step) {
+    struct grci_sim *s = m->sim;
+    struct grci_checkpoints *cp = &s->checkpoints;
+    grci_ensure(cp->interval > 0, GRCI_ERR_SIM, 0, "checkpoints are not enabled");
+    grci_ensure(cp->count > 0 && step >= cp->entries[0].step && step <= s->step_count, GRCI_ERR_SIM, 0,
+                "step %llu was not recorded", (unsigned long long) step);
+
+    int idx = cp->count - 1;
+    while (cp->entries[idx].step > step) {
+        idx--;
+    }
+    while (cp->count > idx + 1) {
+        cp->count--;
+        grci_checkpoint_free(s, &cp->entries[cp->count]);
+    }
+
+    const struct grci_checkpoint *c = &cp->entries[idx];
+    grci_checkpoint_restore(s, c, m->outputs);
+    s->step_count = c->step;
+    grci_sync_states_out(s);
+    cp->host_write = false;
+    if (s->journal.words) {
+        grci_journal_reset(&s->journal);
+    }
+
+    //replaying retakes checkpoints that fall in the replayed range, but those steps were already captured
+    struct grci_capture *capture = s->capture;
+    s->capture = NULL;
+    while (s->step_count < step) {
+        const unsigned char *packed = cp->inputs + (size_t) (s->step_count - cp->input_base) * cp->input_bytes;
+        for (int i = 0; i < m->input_count; i++) {
+            m->inputs[i] = grci_get_bit(packed, i);
+        }
+        grci_step_module(m);
+        if (cp->interval == 0) break;
+    }
+    s->capture = capture;
+    grci_ensure(cp->interval > 0, GRCI_ERR_MEM, 0, "checkpoints were dropped while replaying");
+
+    return GRCI_OK;
+}
+
+//the saved state is kept with its ram pages shared, so this costs little until the rams are written again
+grci_status grci_save_power_on(struct grci_module *m) {
+    struct grci_sim *s = m->sim;
+    grci_ensure(s->sim.foreign_count == 0, GRCI_ERR_SIM, 0, "foreign part state can't be saved for reset");
+    if (s->power_on.bits) {
+        grci_checkpoint_free(s, &s->power_on);
+        s->power_on.bits = NULL;
+    }
+    grci_ensure(grci_checkpoint_fill(s, &s->power_on, m->outputs, NULL), GRCI_ERR_MEM, 0, "placeholder");
+    //the image doesn't count against the checkpoint budget
+    s->power_on.size = 0;
+    return GRCI_OK;
+}
+
+//Puts the module back to step 0 with cleared inputs, and either all state zeroed like a new module or the
+//state saved with grci_save_power_on.  Recorded history and undo journal are dropped
+grci_status grci_reset_module(struct grci_module *m) {
+    struct grci_sim *s = m->sim;
+    struct grci_simulator *sim = &s->sim;
+
+    for (int i = 0; i < s->module.desc->input_count; i++) {
+        s->module.inputs[i]->as.constant = false;
+    }
+    for (int i = 0; i < sim->node_count; i++) {
+        sim->nodes[i].visited = false;
+        sim->nodes[i].cached_state = sim->nodes[i].type == GRCI_NT_CONSTANT && sim->nodes[i].as.constant;
+    }
+    memset(m->inputs, 0, sizeof(bool) * m->input_count);
+    if (s->power_on.bits) {
+        grci_checkpoint_restore(s, &s->power_on, m->outputs);
+    } else {
+        sim->clock->as.constant = 1;
+        sim->clock->cached_state = 1;
+        for (int i = 0; i < sim->dff_node_count; i++) {
+            sim->dff_nodes[i]->as.dff.last_state = false;
+        }
+        memset(m->outputs, 0, sizeof(bool) * m->output_count);
+        for (int r = 0; r < sim->ram_count; r++) {
+            grci_ram_cleanup(&sim->rams[r]);
+        }
+    }
+    //modules with foreign parts have no power-on image, so their foreign state starts zeroed like a new module's
+    for (int i = 0; i < sim->foreign_count; i++) {
+        struct grci_foreign_instance *f = &sim->foreigns[i];
+        memset(f->state, 0, f->desc->foreign->state_size);
+        memset(f->in_values, 0, sizeof(bool) * f->desc->input_count);
+        memset(f->out_values, 0, sizeof(bool) * f->desc->output_count);
+        f->dirty = true;
+    }
+    s->step_count = 0;
+    grci_sync_states_out(s);
+
+    if (s->jit) {
+        for (int i = 0; i < sim->node_count; i++) {
+            s->jit->values[i] = sim->nodes[i].type == GRCI_NT_CONSTANT ? sim->nodes[i].as.constant : sim->nodes[i].cached_state;
+        }
+        if (s->jit->dirty) {
+            memset(s->jit->dirty, 1, s->jit->op_count + 1);
+        }
+    }
+    if (s->timing) {
+        s->timing->resettle = true;
+    }
+    if (sim->toggle_counts) {
+        for (int w = 0; w < grci_activity_word_count(sim); w++) {
+            sim->activity_prev[w] = grci_pack_node_word(sim, w);
+        }
+    }
+    if (s->journal.words) {
+        grci_journal_reset(&s->journal);
+    }
+    if (s->checkpoints.interval > 0) {
+        return grci_set_checkpoints(m, s->checkpoints.interval, s->checkpoints.budget);
+    }
+    return GRCI_OK;
+}
+
+static grci_status grci_add_peer(struct grci_sim *s, struct grci_module *peer) {
+    for (int i = 0; i < s->peer_count; i++) {
+        if (s->peers[i] == peer) return GRCI_OK;
+    }
+    struct grci_module **peers = s->sim.arena.realloc(s->peers, sizeof(struct grci_module*) * (s->peer_count + 1));
+    grci_ensure(peers, GRCI_ERR_MEM, 0, "realloc failed");
+    s->peers = peers;
+    s->peers[s->peer_count++] = peer;
+    return GRCI_OK;
+}
+
+//Gives every module in m's group the same order, with modules after the ones driving them.  Links that
+//form a loop are cut where the search happens to meet them, so those inputs see the previous step's outputs
+static grci_status grci_link_order(struct grci_module *m) {
+    struct grci_simulator *sim = &m->sim->sim;
+    struct grci_module **group = sim->arena.malloc(sizeof(struct grci_module*));
+    grci_ensure(group, GRCI_ERR_MEM, 0, "malloc failed");
+    int count = 1;
+    group[0] = m;
+    for (int i = 0; i < count; i++) {
+        struct grci_sim *s = group[i]->sim;
+        for (int p = 0; p < s->peer_count; p++) {
+            bool seen = false;
+            for (int j = 0; j < count && !seen; j++) {
+                seen = group[j] == s->peers[p];
+            }
+            if (seen) continue;
+            struct grci_module **grown = sim->arena.realloc(group, sizeof(struct grci_module*) * (count + 1));
+            if (!grown) {
+                sim->arena.free(group);
+                grci_ensure(false, GRCI_ERR_MEM, 0, "realloc failed");
+            }
+            group = grown;
+            group[count++] = s->peers[p];
+        }
+    }
+
+    //repeatedly take the first module whose sources are all placed, or the first unplaced one if none is
+    struct grci_module **order = sim->arena.malloc(sizeof(struct grci_module*) * count);
+    if (!order) {
+        sim->arena.free(group);
+        grci_ensure(false, GRCI_ERR_MEM, 0, "malloc failed");
+    }
+    for (int placed = 0; placed < count; placed++) {
+        int pick = -1;
+        for (int i = 0; i < count && pick == -1; i++) {
+            if (!group[i]) continue;
+            bool ready = true;
+            for (int l = 0; l < group[i]->sim->link_count && ready; l++) {
+                struct grci_module *src = group[i]->sim->links[l].src;
+                for (int j = 0; j < count && ready; j++) {
+                    ready = group[j] != src || src == group[i];
+                }
+            }
+            pick = ready ? i : -1;
+        }
+        for (int i = 0; i < count && pick == -1; i++) {
+            pick = group[i] ? i : -1;
+        }
+        order[placed] = group[pick];
+        group[pick] = NULL;
+    }
+    sim->arena.free(group);
+
+    for (int i = 0; i < count; i++) {
+        struct grci_sim *s = order[i]->sim;
+        s->sim.arena.free(s->link_order);
+        s->link_order = NULL;
+        s->link_order_count = 0;
+        if (count == 1) continue;
+        s->link_order = s->sim.arena.malloc(sizeof(struct grci_module*) * count);
+        if (!s->link_order) {
+            sim->arena.free(order);
+            grci_ensure(false, GRCI_ERR_MEM, 0, "malloc failed");
+        }
+        memcpy(s->link_order, order, sizeof(struct grci_module*) * count);
+        s->link_order_count = count;
+    }
+    sim->arena.free(order);
+    return GRCI_OK;
+}
+
+//Drives width inputs of dst, starting at dst_input, from the outputs of src starting at src_output.  Inputs
+//that are linked are overwritten before every grci_step_linked, whatever the host put in them
+grci_status grci_link(struct grci_module *dst, int dst_input, struct grci_module *src, int src_output, int width) {
+    grci_ensure(width > 0 && dst_input >= 0 && dst_input + width <= dst->input_count && 
+                src_output >= 0 && src_output + width <= src->output_count, GRCI_ERR_SIM, 0, "link is out of range");
+    struct grci_sim *s = dst->sim;
+    struct grci_link *links = s->sim.arena.realloc(s->links, sizeof(struct grci_link) * (s->link_count + 1));
+    grci_ensure(links, GRCI_ERR_MEM, 0, "realloc failed");
+    s->links = links;
+    s->links[s->link_count++] = (struct grci_link) { .src = src, .src_output = src_output, .dst_input = dst_input, .width = width };
+
+    //peers are only ever appended, so a failed link is undone by restoring the counts
+    int dst_peers = s->peer_count;
+    int src_peers = src->sim->peer_count;
+    bool ok = (src == dst || (grci_add_peer(s, src) && grci_add_peer(src->sim, dst))) && grci_link_order(dst);
+    if (!ok) {
+        s->link_count--;
+        s->peer_count = dst_peers;
+        src->sim->peer_count = src_peers;
+        //a failed reorder may have dropped part of the old order, so redo it for both groups
+        grci_link_order(dst);
+        if (src != dst) grci_link_order(src);
+        return GRCI_ERR;
+    }
+    return GRCI_OK;
+}
+
+//drops every link to or from m, leaving the rest of its group linked as before
+static void grci_unlink(struct grci_module *m) {
+    struct grci_sim *s = m->sim;
+    for (int p = 0; p < s->peer_count; p++) {
+        struct grci_sim *peer = s->peers[p]->sim;
+        int kept = 0;
+        for (int l = 0; l < peer->link_count; l++) {
+            if (peer->links[l].src != m) {
+                peer->links[kept++] = peer->links[l];
+            }
+        }
+        peer->link_count = kept;
+        kept = 0;
+        for (int i = 0; i < peer->peer_count; i++) {
+            if (peer->peers[i] != m) {
+                peer->peers[kept++] = peer->peers[i];
+            }
+        }
+        peer->peer_count = kept;
+    }
+
+    for (int p = 0; p < s->peer_count; p++) {
+        //a failed reorder only leaves the group stepping in the old order
+        grci_link_order(s->peers[p]);
+    }
+    s->sim.arena.free(s->links);
+    s->sim.arena.free(s->peers);
+    s->sim.arena.free(s->link_order);
+    s->links = NULL;
+    s->peers = NULL;
+    s->link_order = NULL;
+    s->link_count = 0;
+    s->peer_count = 0;
+    s->link_order_count = 0;
+}
+
+//Steps every module linked to m, sources first, copying linked outputs into inputs just before each
+//module steps.  Returns m's clock like grci_step_module
+bool grci_step_linked(struct grci_module *m) {
+    struct grci_sim *s = m->sim;
+    if (s->link_order_count == 0) {
+        for (int l = 0; l < s->link_count; l++) {
+            const struct grci_link *link = &s->links[l];
+            memcpy(m->inputs + link->dst_input, link->src->outputs + link->src_output, sizeof(bool) * link->width);
+        }
+        return grci_step_module(m);
+    }
+
+    for (int i = 0; i < s->link_order_count; i++) {
+        struct grci_module *cur = s->link_order[i];
+        for (int l = 0; l < cur->sim->link_count; l++) {
+            const struct grci_link *link = &cur->sim->links[l];
+            memcpy(cur->inputs + link->dst_input, link->src->outputs + link->src_output, sizeof(bool) * link->width);
+        }
+        grci_step_module(cur);
+    }
+    return s->sim.clock->as.constant;
+}
+
+//Shared with the worker processes.  values holds every part's outputs twice: a step reads the
+//outputs of the step before and writes the other copy, so parts can step in any order or process
+struct grci_mailbox {
+    uint32_t epoch; //bumped by the host to start a step
+    uint32_t done; //steps finished, summed over the workers
+    bool quit;
+    bool clock;
+};
+
+enum grci_source {
+    GRCI_SRC_0 = -1,
+    GRCI_SRC_1 = -2,
+    GRCI_SRC_INPUT = -3 //input i is GRCI_SRC_INPUT - i, and sources from 0 up are part outputs
+};
+
+struct grci_workers {
+    struct grci *g;
+    int *sources; //of every input of every part, in part order
+    int *source_start;
+    int *output_start; //of each part's outputs in values
+    int *top_sources; //of each module output
+    int value_count;
+    int *owner; //worker stepping each part
+
+    int worker_count; //0 steps every part in the host process
+    bool started;
+#if defined(GRCI_FORK_WORKERS)
+    pid_t *pids;
+#endif
+    struct grci_mailbox *box;
+    bool *box_inputs;
+    unsigned char *values[2];
+    size_t shared_size;
+    uint32_t epoch;
+    bool broken; //a worker died mid step, so the workers and host may disagree on epoch
+};
+
+static void grci_partition_run(struct grci_partition *p, int worker, uint32_t epoch, const bool *inputs) {
+    struct grci_workers *w = p->workers;
+    const unsigned char *prev = w->values[(epoch + 1) & 1];
+    unsigned char *next = w->values[epoch & 1];
+    for (int i = 0; i < p->part_count; i++) {
+        if (worker != -1 && w->owner[i] != worker) continue;
+        struct grci_module *part = p->parts[i];
+        for (int k = 0; k < part->input_count; k++) {
+            int src = w->sources[w->source_start[i] + k];
+            part->inputs[k] = src >= 0 ? prev[src] : src == GRCI_SRC_1 ? true : src == GRCI_SRC_0 ? false : inputs[GRCI_SRC_INPUT - src];
+        }
+        grci_step_module(part);
+        for (int k = 0; k < part->output_count; k++) {
+            next[w->output_start[i] + k] = part->outputs[k];
+        }
+    }
+}
+
+#if defined(GRCI_FORK_WORKERS)
+//Spins on the epoch, then yields, then sleeps, so idle workers don't hold a core between host steps
+static void grci_partition_worker(struct grci_partition *p, int worker) {
+    struct grci_workers *w = p->workers;
+    pid_t host = getppid();
+    uint32_t seen = w->epoch;
+    while (true) {
+        uint32_t epoch;
+        for (int spin = 0; (epoch = __atomic_load_n(&w->box->epoch, __ATOMIC_ACQUIRE)) == seen; spin++) {
+            if (spin < GRCI_SPIN_COUNT) continue;
+            if (spin < 2 * GRCI_SPIN_COUNT) {
+                sched_yield();
+                continue;
+            }
+            if (getppid() != host) _exit(1);
+            struct timespec nap = { .tv_sec = 0, .tv_nsec = 50000 };
+            nanosleep(&nap, NULL);
+        }
+        seen = epoch;
+        if (w->box->quit) _exit(0);
+        grci_partition_run(p, worker, epoch, w->box_inputs);
+        __atomic_add_fetch(&w->box->done, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static grci_status grci_partition_start(struct grci_partition *p) {
+    struct grci_workers *w = p->workers;
+    for (int i = 0; i < w->worker_count; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            grci_partition_worker(p, i);
+        }
+        if (pid < 0) {
+            w->box->quit = true;
+            __atomic_store_n(&w->box->epoch, w->epoch + 1, __ATOMIC_RELEASE);
+            for (int k = 0; k < i; k++) {
+                waitpid(w->pids[k], NULL, 0);
+            }
+            w->box->quit = false;
+            __atomic_store_n(&w->box->epoch, w->epoch, __ATOMIC_RELEASE);
+            grci_ensure(false, GRCI_ERR_SIM, 0, "fork failed");
+        }
+        w->pids[i] = pid;
+    }
+    w->started = true;
+    return GRCI_OK;
+}
+
+static grci_status grci_partition_wait(struct grci_partition *p) {
+    struct grci_workers *w = p->workers;
+    uint32_t target = w->epoch * (uint32_t) w->worker_count;
+    for (int spin = 0; __atomic_load_n(&w->box->done, __ATOMIC_ACQUIRE) != target; spin++) {
+        if (spin < GRCI_SPIN_COUNT) continue;
+        sched_yield();
+        if (spin % GRCI_SPIN_COUNT != 0) continue;
+        for (int i = 0; i < w->worker_count; i++) {
+            grci_ensure(waitpid(w->pids[i], NULL, WNOHANG) == 0, GRCI_ERR_SIM, 0, "worker %d exited", i);
+        }
+    }
+    return GRCI_OK;
+}
+#endif
+
+//Steps every part once.  Parts read each other's outputs from the step before, which grci_partition_module
+//only allows for outputs held by dffs or rams, so the parts step like the whole module.  A failed step
+//leaves the partition broken and every later step fails
+grci_status grci_step_partition(struct grci_partition *p) {
+    struct grci_workers *w = p->workers;
+    grci_ensure(!w->broken, GRCI_ERR_SIM, 0, "partition is broken by an earlier failed step");
+#if defined(GRCI_FORK_WORKERS)
+    if (w->worker_count > 0 && !w->started) {
+        grci_ensure(grci_partition_start(p), GRCI_ERR_SIM, 0, "placeholder");
+    }
+#endif
+    w->epoch++;
+    if (w->worker_count == 0) {
+        grci_partition_run(p, -1, w->epoch, p->inputs);
+    } else {
+#if defined(GRCI_FORK_WORKERS)
+        memcpy(w->box_inputs, p->inputs, sizeof(bool) * p->input_count);
+        __atomic_store_n(&w->box->epoch, w->epoch, __ATOMIC_RELEASE);
+        if (!grci_partition_wait(p)) {
+            //workers that saw the epoch have moved on, so there is no step to roll back to
+            w->broken = true;
+            return GRCI_ERR;
+        }
+#endif
+    }
+    const unsigned char *next = w->values[w->epoch & 1];
+    for (int i = 0; i < p->output_count; i++) {
+        int src = w->top_sources[i];
+        p->outputs[i] = src >= 0 ? next[src] : src == GRCI_SRC_1 ? true : src == GRCI_SRC_0 ? false : p->inputs[GRCI_SRC_INPUT - src];
+    }
+    return GRCI_OK;
+}
+
+void grci_destroy_partition(struct grci_partition *p) {
+    if (!p) return;
+    struct grci_workers *w = p->workers;
+    void (*free)(void*) = w->g->client_free;
+#if defined(GRCI_FORK_WORKERS)
+    if (w->started) {
+        w->box->quit = true;
+        __atomic_store_n(&w->box->epoch, w->epoch + 1, __ATOMIC_RELEASE);
+        for (int i = 0; i < w->worker_count; i++) {
+            waitpid(w->pids[i], NULL, 0);
+        }
+    }
+    if (w->worker_count > 0) {
+        if (w->box) {
+            munmap(w->box, w->shared_size);
+        }
+    } else {
+        free(w->box);
+    }
+    free(w->pids);
+#else
+    free(w->box);
+#endif
+    for (int i = 0; i < p->part_count; i++) {
+        if (p->parts[i]) {
+            grci_destroy_module(p->parts[i]);
+        }
+    }
+    free(w->sources);
+    free(w->source_start);
+    free(w->output_start);
+    free(w->top_sources);
+    free(w->owner);
+    free(w);
+    free(p->parts);
+    free(p->inputs);
+    free(p->outputs);
+    free(p);
+}
+
+//Splits a module into one module per top level part, connected like the parts are.  worker_count
+//processes step the parts, with boundary values exchanged through shared memory once per step, so every
+//part output read by a part must come straight from a dff or ram.  Those hold their value for a step
+//anyway, which keeps the parts stepping exactly like the whole module.
+//0 steps everything in the host process, for checking against the workers, and a negative count
+//starts one worker per core.  Workers start on the first step
+struct grci_partition *grci_partition_module(struct grci *g, const char *module_name, size_t len, int worker_count) {
+    struct grci_string string = { .ptr = module_name, .len = len };
+    const struct grci_module_desc *desc = grci_module_desc_list_get(&g->compiler.module_defs, &string);
+    grci_ensure_retnull(desc, GRCI_ERR_SIM, 0, "module %.*s does not exist", (int) len, module_name);
+    grci_ensure_retnull(desc->part_count > 0 && !desc->is_nand && !desc->is_dff && !desc->is_ram64K && !desc->foreign,
+                        GRCI_ERR_SIM, 0, "module %.*s has no parts to split", (int) len, module_name);
+#if defined(GRCI_FORK_WORKERS)
+    if (worker_count < 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        worker_count = cores > 0 ? (int) cores : 1;
+    }
+#else
+    grci_ensure_retnull(worker_count == 0, GRCI_ERR_SIM, 0, "worker processes aren't supported on this platform");
+#endif
+    worker_count = worker_count < desc->part_count ? worker_count : desc->part_count;
+
+    int source_count = 0;
+    for (int i = 0; i < desc->part_count; i++) {
+        source_count += desc->parts[i]->input_count;
+    }
+
+    void *(*malloc)(size_t) = g->client_malloc;
+    struct grci_partition *p = malloc(sizeof(struct grci_partition));
+    struct grci_workers *w = malloc(sizeof(struct grci_workers));
+    grci_ensure_retnull(p && w, GRCI_ERR_MEM, 0, "malloc failed");
+    memset(p, 0, sizeof(struct grci_partition));
+    memset(w, 0, sizeof(struct grci_workers));
+    p->workers = w;
+    w->g = g;
+    w->worker_count = worker_count;
+    p->input_count = desc->input_count;
+    p->output_count = desc->output_count;
+    p->part_count = desc->part_count;
+    p->inputs = malloc(sizeof(bool) * (desc->input_count + 1));
+    p->outputs = malloc(sizeof(bool) * (desc->output_count + 1));
+    p->parts = malloc(sizeof(struct grci_module*) * desc->part_count);
+    w->sources = malloc(sizeof(int) * (source_count + 1));
+    w->source_start = malloc(sizeof(int) * desc->part_count);
+    w->output_start = malloc(sizeof(int) * desc->part_count);
+    w->top_sources = malloc(sizeof(int) * (desc->output_count + 1));
+    w->owner = malloc(sizeof(int) * desc->part_count);
+#if defined(GRCI_FORK_WORKERS)
+    w->pids = malloc(sizeof(pid_t) * (worker_count + 1));
+    bool ok = w->pids;
+#else
+    bool ok = true;
+#endif
+    ok = ok && p->inputs && p->outputs && p->parts && w->sources && w->source_start && w->output_start && w->top_sources && w->owner;
+    if (p->parts) {
+        memset(p->parts, 0, sizeof(struct grci_module*) * desc->part_count);
+    }
+    if (!ok) {
+        p->part_count = 0;
+        grci_destroy_partition(p);
+        grci_ensure_retnull(false, GRCI_ERR_MEM, 0, "malloc failed");
+    }
+    memset(p->inputs, 0, sizeof(bool) * desc->input_count);
+    memset(p->outputs, 0, sizeof(bool) * desc->output_count);
+
+    for (int i = 0; i < desc->part_count; i++) {
+        const struct grci_module_desc *part = desc->parts[i];
+        p->parts[i] = grci_init_module(g, part->name.ptr, part->name.len);
+        if (!p->parts[i]) {
+            grci_destroy_partition(p);
+            return NULL;
+        }
+        w->output_start[i] = w->value_count;
+        w->value_count += part->output_count;
+    }
+
+    //sources are resolved the way grci_make_module connects parts
+    int *src = w->sources;
+    for (int i = 0; i < desc->part_count; i++) {
+        w->source_start[i] = (int) (src - w->sources);
+        const struct grci_connection_list *conns = &desc->part_connections[i];
+        for (int k = 0; k < conns->count; k++) {
+            struct grci_connection c = conns->values[k];
+            switch (c.type) {
+            case GRCI_IT_EXTERNAL:
+                *src++ = GRCI_SRC_INPUT - c.get.parameter_idx;
+                break;
+            case GRCI_IT_INTERNAL: {
+                const struct grci_node *driver = p->parts[c.get.part.idx]->sim->module.outputs[c.get.part.output_idx];
+                if (driver->type != GRCI_NT_DFF && driver->type != GRCI_NT_RAM64KOUT) {
+                    int from = c.get.part.idx;
+                    grci_destroy_partition(p);
+                    grci_ensure_retnull(false, GRCI_ERR_SIM, 0, "part %d reads part %d output %d, which isn't held by a dff or ram, "
+                                        "so it can't cross between parts", i, from, c.get.part.output_idx);
+                }
+                *src++ = w->output_start[c.get.part.idx] + c.get.part.output_idx;
+                break;
+            }
+            case GRCI_IT_CONSTANT:
+                *src++ = c.get.constant ? GRCI_SRC_1 : GRCI_SRC_0;
+                break;
+            default:
+                grci_destroy_partition(p);
+                grci_ensure_retnull(false, GRCI_ERR_SIM, 0, "part %d reads the clock, which can't cross between processes", i);
+            }
+        }
+    }
+    for (int i = 0; i < desc->output_count; i++) {
+        const struct grci_element *out = &desc->outputs[i];
+        w->top_sources[i] = out->idx == GRCI_OUTPUT_1 ? GRCI_SRC_1 : out->idx < 0 ? GRCI_SRC_0 : w->output_start[out->idx] + out->output_idx;
+    }
+
+    //largest parts first, each to the worker with the fewest nodes so far
+    int *loads = malloc(sizeof(int) * (worker_count + 1));
+    if (!loads) {
+        grci_destroy_partition(p);
+        grci_ensure_retnull(false, GRCI_ERR_MEM, 0, "malloc failed");
+    }
+    memset(loads, 0, sizeof(int) * (worker_count + 1));
+    for (int i = 0; i < desc->part_count; i++) {
+        w->owner[i] = -1;
+    }
+    for (int placed = 0; placed < desc->part_count; placed++) {
+        int pick = -1;
+        for (int i = 0; i < desc->part_count; i++) {
+            if (w->owner[i] == -1 && (pick == -1 || desc->parts[i]->node_count > desc->parts[pick]->node_count)) {
+                pick = i;
+            }
+        }
+        int least = 0;
+        for (int k = 1; k < worker_count; k++) {
+            least = loads[k] < loads[least] ? k : least;
+        }
+        w->owner[pick] = least;
+        loads[least] += desc->parts[pick]->node_count;
+    }
+    g->client_free(loads);
+
+    w->shared_size = sizeof(struct grci_mailbox) + desc->input_count + 2 * (size_t) w->value_count + 16;
+#if defined(GRCI_FORK_WORKERS)
+    if (worker_count > 0) {
+        void *shared = mmap(NULL, w->shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        w->box = shared == MAP_FAILED ? NULL : shared;
+    } else {
+        w->box = malloc(w->shared_size);
+    }
+#else
+    w->box = malloc(w->shared_size);
+#endif
+    if (!w->box) {
+        grci_destroy_partition(p);
+        grci_ensure_retnull(false, GRCI_ERR_MEM, 0, "could not map the mailbox");
+    }
+    memset(w->box, 0, w->shared_size);
+    w->box_inputs = (bool*) (w->box + 1);
+    w->values[0] = (unsigned char*) (w->box_inputs + desc->input_count);
+    w->values[1] = w->values[0] + w->value_count;
+    return p;
+}
+
+grci_status grci_set_activity(struct grci_module *m, bool enabled) {
+    if (!enabled) {
+        grci_activity_disable(&m->sim->sim);
+        return GRCI_OK;
+    }
+    return grci_activity_enable(&m->sim->sim);
+}
+
+grci_status grci_activity(struct grci_module *m, const char *submodule_name, size_t len, struct grci_activity *activity) {
+    struct grci_simulator *sim = &m->sim->sim;
+    grci_ensure(sim->toggle_counts, GRCI_ERR_SIM, 0, "activity recording is not enabled");
+
+    int off = 0;
+    int count = sim->node_count;
+    if (submodule_name) {
+        grci_ensure(grci_part_node_range(m->sim->module.desc, submodule_name, len, &off, &count, NULL),
+                    GRCI_ERR_SIM, 0, "placeholder");
+    }
+
+    activity->node_count = 0;
+    activity->idle_count = 0;
+    activity->toggles = 0;
+    activity->steps = sim->activity_steps;
+    if (!submodule_name) {
+        activity->toggles = sim->activity_total;
+    }
+
+    for (int j = off; j < off + count; j++) {
+        //the whole module is every current node, a submodule is its instantiation range minus fused away nodes
+        int i = submodule_name ? grci_node_pos(sim, j) : j;
+        if (i < 0) continue;
+        activity->node_count++;
+        if (submodule_name) {
+            activity->toggles += sim->toggle_counts[i];
+        }
+        if (sim->toggle_counts[i] == 0 && sim->nodes[i].type != GRCI_NT_CONSTANT) {
+            activity->idle_count++;
+        }
+    }
+
+    return GRCI_OK;
+}
+
+static void grci_append(char *buf, size_t size, size_t *off, const char *fmt, ...) {
+    if (*off + 1 >= size) return;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf + *off, size - *off, fmt, args);
+    va_end(args);
+    if (n > 0) {
+        *off = *off + n < size ? *off + n : size - 1;
+    }
+}
+
+//Dotted part path of the node at position i, with unnamed parts shown as Module#index.  Parts of
+//several nodes with nothing below them, like a Ram64K, end with the node's offset in brackets
+static void grci_node_name(const struct grci_sim *s, int i, char *buf, size_t size, size_t *off) {
+    const struct grci_simulator *sim = &s->sim;
+    const struct grci_module_desc *desc = s->module.desc;
+    for (int k = 0; k < desc->input_count; k++) {
+        if (s->module.inputs[k] == &sim->nodes[i]) {
+            grci_append(buf, size, off, "input %d", k);
+            return;
+        }
+    }
+    static const char *fixed[] = { "const0", "const1", "clock" };
+    int idx = sim->node_orig ? sim->node_orig[i] : i;
+    if (idx < 3) {
+        grci_append(buf, size, off, "%s", fixed[idx]);
+        return;
+    }
+
+    int base = 3;
+    bool first = true;
+    while (desc->part_count > 0) {
+        int p = 0;
+        while (p < desc->part_count - 1 && idx >= base + desc->parts[p]->node_count) {
+            base += desc->parts[p]->node_count;
+            p++;
+        }
+        const struct grci_string *name = desc->part_names[p].ptr ? &desc->part_names[p] : &desc->parts[p]->name;
+        grci_append(buf, size, off, first ? "%.*s" : ".%.*s", name->len, name->ptr);
+        if (!desc->part_names[p].ptr) {
+            grci_append(buf, size, off, "#%d", p);
+        }
+        first = false;
+        desc = desc->parts[p];
+    }
+    if (desc->node_count > 1) {
+        grci_append(buf, size, off, "[%d]", idx - base);
+    }
+}
+
+//Longest nand paths, found in one pass over the gates in topological order.  Paths start at dffs,
+//ram outputs and module inputs and end at dff and ram inputs and module outputs.  A ram read is
+//one level, like a gate.  Depths are for the whole module, while depth, loop_count and the histogram
+//cover only the named part if submodule_name isn't NULL
+grci_status grci_depth(struct grci_module *m, const char *submodule_name, size_t len, struct grci_depth *depth) {
+    struct grci_sim *s = m->sim;
+    struct grci_simulator *sim = &s->sim;
+    int n = sim->node_count;
+    grci_ensure(sim->foreign_count == 0, GRCI_ERR_SIM, 0, "modules with foreign parts have no nand depth");
+    grci_ensure(!sim->fused, GRCI_ERR_SIM, 0, "depths are counted in nands, and this module has fused gates");
+
+    int off = 0;
+    int count = n;
+    if (submodule_name) {
+        grci_ensure(grci_part_node_range(s->module.desc, submodule_name, len, &off, &count, NULL),
+                    GRCI_ERR_SIM, 0, "placeholder");
+    }
+
+    //arrival[0] is the depth from the nearest register, arrival[1] from the module inputs, and -1 if
+    //nothing of that kind reaches the node.  level counts constants as sources too
+    int *arrival[2], *from[2], *level, *pending, *users_start, *users, *fill, *queue, *ram_pending;
+    struct grci_arena scratch;
+    grci_ensure(grci_arena_init(&scratch, sim->arena.malloc, sim->arena.realloc, sim->arena.free), GRCI_ERR_MEM, 0, "placeholder");
+    bool ok = grci_arena_malloc(&scratch, sizeof(int) * n, (void**) &arrival[0]) &&
+              grci_arena_malloc(&scratch, sizeof(int) * n, (void**) &arrival[1]) &&
+              grci_arena_malloc(&scratch, sizeof(int) * n, (void**) &from[0]) &&
+              grci_arena_malloc(&scratch, sizeof(int) * n, (void**) &from[1]) &&
+              grci_arena_calloc(&scratch, n, sizeof(int), (void**) &level) &&
+              grci_arena_calloc(&scratch, n, sizeof(int), (void**) &pending) &&
+              grci_arena_calloc(&scratch, n + 1, sizeof(int), (void**) &users_start) &&
+              grci_arena_malloc(&scratch, sizeof(int) * n, (void**) &queue) &&
+              grci_arena_malloc(&scratch, sizeof(int) * (sim->ram_count + 1), (void**) &ram_pending);
+
+    //users of each node: gates, and rams through their addresses as -(ram index) - 1
+    for (int pass = 0; ok && pass < 2; pass++) {
+        for (int i = 0; i < n; i++) {
+            struct grci_node **slots[3];
+            int operand_count = grci_node_operands(&sim->nodes[i], slots);
+            for (int k = 0; k < operand_count; k++) {
+                int op = (int) (*slots[k] - sim->nodes);
+                if (pass == 0) {
+                    users_start[op + 1]++;
+                } else {
+                    users[fill[op]++] = i;
+                }
+            }
+            pending[i] = operand_count;
+        }
+        for (int r = 0; r < sim->ram_count; r++) {
+            for (int k = 0; k < 16; k++) {
+                int op = (int) (sim->rams[r].addrs[k] - sim->nodes);
+                if (pass == 0) {
+                    users_start[op + 1]++;
+                } else {
+                    users[fill[op]++] = -r - 1;
+                }
+            }
+            ram_pending[r] = 16;
+        }
+        if (pass == 0) {
+            for (int i = 0; i < n; i++) {
+                users_start[i + 1] += users_start[i];
+            }
+            ok = grci_arena_malloc(&scratch, sizeof(int) * (users_start[n] + 1), (void**) &users) &&
+                 grci_arena_malloc(&scratch, sizeof(int) * (n + 1), (void**) &fill);
+            if (ok) {
+                memcpy(fill, users_start, sizeof(int) * n);
+            }
+        }
+    }
+    if (!ok) {
+        grci_arena_cleanup(&scratch);
+        grci_ensure(false, GRCI_ERR_MEM, 0, "placeholder");
+    }
+
+    int head = 0;
+    int tail = 0;
+    for (int i = 0; i < n; i++) {
+        enum grci_node_type type = sim->nodes[i].type;
+        arrival[0][i] = type == GRCI_NT_DFF || type == GRCI_NT_RAM64KOUT ? 0 : -1;
+        arrival[1][i] = -1;
+        from[0][i] = -1;
+        from[1][i] = -1;
+        if (pending[i] == 0 && type != GRCI_NT_RAM64KOUT) {
+            queue[tail++] = i;
+        }
+    }
+    for (int k = 0; k < s->module.desc->input_count; k++) {
+        arrival[1][s->module.inputs[k] - sim->nodes] = 0;
+    }
+
+    while (head < tail) {
+        int v = queue[head++];
+        for (int u = users_start[v]; u < users_start[v + 1]; u++) {
+            int user = users[u];
+            int ready[16];
+            int ready_count = 0;
+            if (user >= 0) {
+                if (--pending[user] == 0) ready[ready_count++] = user;
+            } else if (--ram_pending[-user - 1] == 0) {
+                for (int k = 0; k < 16; k++) {
+                    ready[ready_count++] = (int) (sim->rams[-user - 1].outputs[k] - sim->nodes);
+                }
+            }
+            for (int j = 0; j < ready_count; j++) {
+                int g = ready[j];
+                struct grci_node **slots[16];
+                int operand_count;
+                if (sim->nodes[g].type == GRCI_NT_RAM64KOUT) {
+                    for (int k = 0; k < 16; k++) {
+                        slots[k] = &sim->rams[-user - 1].addrs[k];
+                    }
+                    operand_count = 16;
+                } else {
+                    operand_count = grci_node_operands(&sim->nodes[g], slots);
+                }
+                for (int k = 0; k < operand_count; k++) {
+                    int op = (int) (*slots[k] - sim->nodes);
+                    if (level[op] + 1 > level[g]) level[g] = level[op] + 1;
+                    for (int kind = 0; kind < 2; kind++) {
+                        if (arrival[kind][op] >= 0 && arrival[kind][op] + 1 > arrival[kind][g]) {
+                            arrival[kind][g] = arrival[kind][op] + 1;
+                            from[kind][g] = op;
+                        }
+                    }
+                }
+                queue[tail++] = g;
+            }
+        }
+    }
+
+    //endpoints: the node feeding a dff or ram input, and module outputs
+    depth->register_depth = -1;
+    depth->io_depth = -1;
+    int best = -1;
+    int best_kind = 0;
+    int best_sink = -1; //node of the dff or ram output reading it, or -(output index) - 1
+    for (int k = 0; k < sim->dff_node_count + sim->ram_count * 33 + s->module.desc->output_count; k++) {
+        int e, sink;
+        if (k < sim->dff_node_count) {
+            if (sim->dff_nodes[k]->type != GRCI_NT_DFF) continue;
+            e = (int) (sim->dff_nodes[k]->as.dff.input - sim->nodes);
+            sink = (int) (sim->dff_nodes[k] - sim->nodes);
+        } else if (k < sim->dff_node_count + sim->ram_count * 33) {
+            int j = k - sim->dff_node_count;
+            struct grci_ram64k *ram = &sim->rams[j / 33];
+            struct grci_node *in = j % 33 < 16 ? ram->inputs[j % 33] : j % 33 < 32 ? ram->addrs[j % 33 - 16] : ram->load;
+            e = (int) (in - sim->nodes);
+            sink = (int) (ram->outputs[0] - sim->nodes);
+        } else {
+            int j = k - sim->dff_node_count - sim->ram_count * 33;
+            e = (int) (s->module.outputs[j] - sim->nodes);
+            sink = -j - 1;
+        }
+        int *io = sink >= 0 ? &depth->register_depth : &depth->io_depth;
+        if (arrival[sink >= 0 ? 0 : 1][e] > *io) {
+            *io = arrival[sink >= 0 ? 0 : 1][e];
+        }
+        for (int kind = 0; kind < 2; kind++) {
+            if (best == -1 || arrival[kind][e] > arrival[best_kind][best]) {
+                best = e;
+                best_kind = kind;
+                best_sink = sink;
+            }
+        }
+    }
+
+    depth->depth = 0;
+    depth->loop_count = 0;
+    if (depth->histogram) {
+        memset(depth->histogram, 0, sizeof(int) * depth->histogram_size);
+    }
+    for (int j = off; j < off + count; j++) {
+        int i = submodule_name ? grci_node_pos(sim, j) : j;
+        if (i < 0 || sim->nodes[i].type != GRCI_NT_NAND) continue;
+        if (pending[i] > 0) {
+            depth->loop_count++;
+            continue;
+        }
+        if (level[i] > depth->depth) {
+            depth->depth = level[i];
+        }
+        if (depth->histogram && depth->histogram_size > 0) {
+            depth->histogram[level[i] < depth->histogram_size ? level[i] : depth->histogram_size - 1]++;
+        }
+    }
+
+    if (depth->path && depth->path_size > 0) {
+        depth->path[0] = '\0';
+        size_t written = 0;
+        if (best != -1 && arrival[best_kind][best] >= 0) {
+            //walked back from the end, so the nodes are collected first
+            int path_len = 0;
+            for (int v = best; v != -1; v = from[best_kind][v]) {
+                queue[path_len++] = v;
+            }
+            for (int p = path_len - 1; p >= 0; p--) {
+                grci_node_name(s, queue[p], depth->path, depth->path_size, &written);
+                grci_append(depth->path, depth->path_size, &written, " > ");
+            }
+            if (best_sink >= 0) {
+                grci_node_name(s, best_sink, depth->path, depth->path_size, &written);
+            } else {
+                grci_append(depth->path, depth->path_size, &written, "output %d", -best_sink - 1);
+            }
+        }
+    }
+
+    grci_arena_cleanup(&scratch);
+    return GRCI_OK;
+}
+
+//Ram64K parts are addressed like submodules, with a dotted path for nested parts.  Only named top level
+//rams have submodule states, and sub is set to them so they can be kept in sync with the ram pages
+static grci_status grci_find_ram(struct grci_module *m, const char *submodule_name, size_t len, struct grci_ram64k **ram, struct grci_submodule **sub) {
+    const struct grci_simulator *sim = &m->sim->sim;
+    int off, count;
+    const struct grci_module_desc *part;
+    grci_ensure(grci_part_node_range(m->sim->module.desc, submodule_name, len, &off, &count, &part), GRCI_ERR_SIM, 0, "placeholder");
+    grci_ensure(part->is_ram64K, GRCI_ERR_SIM, 0, "submodule %.*s is not a Ram64K", (int) len, submodule_name);
+
+    //a ram's first node is its first output
+    const struct grci_node *node = &sim->nodes[grci_node_pos(sim, off)];
+    assert(node->type == GRCI_NT_RAM64KOUT);
+    *ram = node->as.ram64Kout.ram;
+
+    *sub = NULL;
+    const struct grci_module_desc *desc = m->sim->module.desc;
+    for (int i = 0; i < desc->part_count; i++) {
+        if (desc->part_names[i].ptr && grci_string_matches(&desc->part_names[i], submodule_name, len)) {
+            *sub = &m->sim->module.submodules[i];
+        }
+    }
+    return GRCI_OK;
+}
+
+//Addresses are byte offsets into the ram.  A word read at address a is bytes a and a + 1, low byte first
+grci_status grci_ram_load(struct grci_module *m, const char *submodule_name, size_t len, size_t offset, const void *data, size_t size) {
+    struct grci_ram64k *ram;
+    struct grci_submodule *sub;
+    grci_ensure(grci_find_ram(m, submodule_name, len, &ram, &sub), GRCI_ERR_SIM, 0, "placeholder");
+    grci_ensure(offset <= GRCI_RAM64K_SIZE && size <= GRCI_RAM64K_SIZE - offset, GRCI_ERR_SIM, 0, 
+                "%zu bytes at offset %zu don't fit in Ram64K", size, offset);
+
+    m->sim->checkpoints.host_write = true;
+    grci_ensure(grci_ram_write(ram, offset, data, size), GRCI_ERR_MEM, 0, "placeholder");
+
+    //submodule states are written back into the ram on every step, so they need the image too
+    if (sub && sub->states) {
+        const unsigned char *bytes = data;
+        for (size_t i = 0; i < size; i++) {
+            for (int bit = 0; bit < 8; bit++) {
+                sub->states[(offset + i) * 8 + bit] = (bytes[i] >> bit) & 1;
+            }
+        }
+    }
+    return GRCI_OK;
+}
+
+grci_status grci_ram_dump(struct grci_module *m, const char *submodule_name, size_t len, size_t offset, void *data, size_t size) {
+    struct grci_ram64k *ram;
+    struct grci_submodule *sub;
+    grci_ensure(grci_find_ram(m, submodule_name, len, &ram, &sub), GRCI_ERR_SIM, 0, "placeholder");
+    grci_ensure(offset <= GRCI_RAM64K_SIZE && size <= GRCI_RAM64K_SIZE - offset, GRCI_ERR_SIM, 0, 
+                "%zu bytes at offset %zu don't fit in Ram64K", size, offset);
+
+    grci_ram_read(ram, offset, data, size);
+    return GRCI_OK;
+}
+
+//The whole file is loaded at offset.  Where available the file is mapped rather than read into a buffer first
+grci_status grci_ram_load_file(struct grci_module *m, const char *submodule_name, size_t len, size_t offset, const char *path) {
+#if !defined(_WIN32)
+    int fd = open(path, O_RDONLY);
+    grci_ensure(fd != -1, GRCI_ERR_IO, 0, "can't open '%s'", path);
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && st.st_size <= GRCI_RAM64K_SIZE) {
+        void *image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (image != MAP_FAILED) {
+            close(fd);
+            bool ok = grci_ram_load(m, submodule_name, len, offset, image, st.st_size);
+            munmap(image, st.st_size);
+            return ok;
+        }
+    }
+    close(fd);
+#endif
+
+    //fall back to reading, which also reports files too big for the ram
+    FILE *f = fopen(path, "rb");
+    grci_ensure(f, GRCI_ERR_IO, 0, "can't open '%s'", path);
+    unsigned char *image = m->sim->g->client_malloc(GRCI_RAM64K_SIZE + 1);
+    size_t size = image ? fread(image, 1, GRCI_RAM64K_SIZE + 1, f) : 0;
+    bool read_ok = image && !ferror(f);
+    fclose(f);
+
+    bool ok = read_ok && grci_ram_load(m, submodule_name, len, offset, image, size);
+    m->sim->g->client_free(image);
+    grci_ensure(read_ok, GRCI_ERR_IO, 0, "failed reading '%s'", path);
+    return ok;
+}
+
+grci_status grci_ram_dump_file(struct grci_module *m, const char *submodule_name, size_t len, size_t offset, size_t size, const char *path) {
+    struct grci_ram64k *ram;
+    struct grci_submodule *sub;
+    grci_ensure(grci_find_ram(m, submodule_name, len, &ram, &sub), GRCI_ERR_SIM, 0, "placeholder");
+    grci_ensure(offset <= GRCI_RAM64K_SIZE && size <= GRCI_RAM64K_SIZE - offset, GRCI_ERR_SIM, 0, 
+                "%zu bytes at offset %zu don't fit in Ram64K", size, offset);
+
+    FILE *f = fopen(path, "wb");
+    grci_ensure(f, GRCI_ERR_IO, 0, "can't open '%s' for writing", path);
+    bool ok = true;
+    while (ok && size > 0) {
+        //writing page by page straight from the ram
+        size_t page_off = offset % GRCI_RAM_PAGE_SIZE;
+        size_t n = GRCI_RAM_PAGE_SIZE - page_off < size ? GRCI_RAM_PAGE_SIZE - page_off : size;
+        ok = fwrite(ram->pages[offset / GRCI_RAM_PAGE_SIZE]->bytes + page_off, 1, n, f) == n;
+        offset += n;
+        size -= n;
+    }
+    ok = fclose(f) == 0 && ok;
+    grci_ensure(ok, GRCI_ERR_IO, 0, "failed writing '%s'", path);
+    return GRCI_OK;
+}
+
+//dst takes references to src's pages, so both read the same image until either one writes to a page.
+//Modules sharing pages must come from the same grci, and aren't safe to step from different threads
+grci_status grci_ram_share(struct grci_module *dst, const char *dst_name, size_t dst_len, struct grci_module *src, const char *src_name, size_t src_len) {
+    struct grci_ram64k *to, *from;
+    struct grci_submodule *to_sub, *from_sub;
+    grci_ensure(grci_find_ram(dst, dst_name, dst_len, &to, &to_sub), GRCI_ERR_SIM, 0, "placeholder");
+    grci_ensure(grci_find_ram(src, src_name, src_len, &from, &from_sub), GRCI_ERR_SIM, 0, "placeholder");
+    if (to == from) return GRCI_OK;
+    dst->sim->checkpoints.host_write = true;
+
+    for (int i = 0; i < GRCI_RAM_PAGE_COUNT; i++) {
+        struct grci_ram_page *page = from->pages[i];
+        if (page != &grci_zero_page) {
+            page->refs++;
+        }
+        grci_ram_page_release(to, to->pages[i]);
+        to->pages[i] = page;
+    }
+
+    if (to_sub && to_sub->states) {
+        for (int i = 0; i < GRCI_RAM64K_STATE_COUNT; i++) {
+            to_sub->states[i] = (grci_ram_read_byte(to, i / 8) >> (i % 8)) & 1;
+        }
+    }
+    return GRCI_OK;
+}
+
+static inline void grci_add_edge(int *degree, int *adj, int *fill, const struct grci_simulator *sim, const struct grci_node *a, const struct grci_node *b) {
+    int i = (int) (a - sim->nodes);
+    int j = (int) (b - sim->nodes);
+    if (adj) {
+        adj[fill[i]++] = j;
+        adj[fill[j]++] = i;
+    } else {
+        degree[i]++;
+        degree[j]++;
+    }
+}
+
+//undirected adjacency in compressed rows.  Called once with adj NULL to count degrees and once more to fill
+static void grci_node_edges(const struct grci_simulator *sim, int *degree, int *adj, int *fill) {
+    for (int i = 0; i < sim->node_count; i++) {
+        struct grci_node *n = &sim->nodes[i];
+        struct grci_node **slots[3];
+        int operand_count = grci_node_operands(n, slots);
+        for (int k = 0; k < operand_count; k++) {
+            grci_add_edge(degree, adj, fill, sim, n, *slots[k]);
+        }
+        if (n->type == GRCI_NT_DFF) {
+            grci_add_edge(degree, adj, fill, sim, n, n->as.dff.input);
+        }
+    }
+
+    //ram inputs are tied to the first output, and the outputs are chained to keep them together
+    for (int r = 0; r < sim->ram_count; r++) {
+        const struct grci_ram64k *ram = &sim->rams[r];
+        for (int i = 0; i < 16; i++) {
+            grci_add_edge(degree, adj, fill, sim, ram->outputs[0], ram->inputs[i]);
+            grci_add_edge(degree, adj, fill, sim, ram->outputs[0], ram->addrs[i]);
+            if (i > 0) {
+                grci_add_edge(degree, adj, fill, sim, ram->outputs[i - 1], ram->outputs[i]);
+            }
+        }
+        grci_add_edge(degree, adj, fill, sim, ram->outputs[0], ram->load);
+    }
+}
+
+//reverse Cuthill-McKee: breadth first from a low degree node of each component, visiting
+//neighbours by increasing degree, then reversed
+static grci_status grci_order_rcm(const struct grci_simulator *sim, struct grci_arena *scratch, int *order) {
+    int n = sim->node_count;
+    int *degree, *start, *fill, *adj;
+    bool *placed;
+    grci_ensure(grci_arena_calloc(scratch, n, sizeof(int), (void**) &degree), GRCI_ERR_MEM, 0, "placeholder");
+    grci_ensure(grci_arena_malloc(scratch, sizeof(int) * (n + 1), (void**) &start), GRCI_ERR_MEM, 0, "placeholder");
+    grci_ensure(grci_arena_malloc(scratch, sizeof(int) * n, (void**) &fill), GRCI_ERR_MEM, 0, "placeholder");
+    grci_ensure(grci_arena_calloc(scratch, n, sizeof(bool), (void**) &placed), GRCI_ERR_MEM, 0, "placeholder");
+
+    grci_node_edges(sim, degree, NULL, NULL);
+    start[0] = 0;
+    for (int i = 0; i < n; i++) {
+        start[i + 1] = start[i] + degree[i];
+        fill[i] = start[i];
+    }
+    grci_ensure(grci_arena_malloc(scratch, sizeof(int) * (start[n] + 1), (void**) &adj), GRCI_ERR_MEM, 0, "placeholder");
+    grci_node_edges(sim, degree, adj, fill);
+
+    //sort each row by degree so the breadth first walk visits low degree neighbours first
+    for (int i = 0; i < n; i++) {
+        for (int j = start[i] + 1; j < start[i + 1]; j++) {
+            int v = adj[j];
+            int k = j - 1;
+            while (k >= start[i] && degree[adj[k]] > degree[v]) {
+                adj[k + 1] = adj[k];
+                k--;
+            }
+            adj[k + 1] = v;
+        }
+    }
+
+    int count = 0;
+    for (int min_degree = 0; count < n; min_degree++) {
+        for (int root = 0; root < n && count < n; root++) {
+            if (placed[root] || degree[root] > min_degree) continue;
+            int head = count;
+            order[count++] = root;
+            placed[root] = true;
+            while (head < count) {
+                int v = order[head++];
+                for (int j = start[v]; j < start[v + 1]; j++) {
+                    if (!placed[adj[j]]) {
+                        placed[adj[j]] = true;
+                        order[count++] = adj[j];
+                    }
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < n / 2; i++) {
+        int tmp = order[i];
+        order[i] = order[n - 1 - i];
+        order[n - 1 - i] = tmp;
+    }
+
+    return GRCI_OK;
+}
+
+//Nodes are grouped by logic level: constants, dffs and ram outputs first, then every gate after
+//the nodes that drive it.  Order within a level is kept.  Gates on a combinational loop have no
+//level and go last.
+static grci_status grci_order_level(const struct grci_simulator *sim, struct grci_arena *scratch, int *order) {
+    int n = sim->node_count;
+    int *level;
+    grci_ensure(grci_arena_malloc(scratch, sizeof(int) * n, (void**) &level), GRCI_ERR_MEM, 0, "placeholder");
+
+    int max_level = 0;
+    struct grci_node **slots[3];
+    for (int i = 0; i < n; i++) {
+        level[i] = grci_node_operands(&sim->nodes[i], slots) > 0 ? -1 : 0;
+    }
+    //relax until stable.  Gates mostly come after their inputs already, so this takes few passes
+    bool changed = true;
+    for (int pass = 0; changed && pass <= n; pass++) {
+        changed = false;
+        for (int i = 0; i < n; i++) {
+            int operand_count = grci_node_operands(&sim->nodes[i], slots);
+            if (operand_count == 0 || level[i] != -1) continue;
+            int max = 0;
+            for (int k = 0; k < operand_count && max != -1; k++) {
+                int l = level[*slots[k] - sim->nodes];
+                max = l == -1 || l > max ? l : max;
+            }
+            if (max == -1) continue;
+            level[i] = max + 1;
+            if (level[i] > max_level) max_level = level[i];
+            changed = true;
+        }
+    }
+
+    //counting sort by level, with unleveled nodes in the last bucket
+    int *bucket;
+    grci_ensure(grci_arena_calloc(scratch, max_level + 3, sizeof(int), (void**) &bucket), GRCI_ERR_MEM, 0, "placeholder");
+    for (int i = 0; i < n; i++) {
+        int l = level[i] == -1 ? max_level + 1 : level[i];
+        bucket[l + 1]++;
+    }
+    for (int l = 0; l < max_level + 2; l++) {
+        bucket[l + 1] += bucket[l];
+    }
+    for (int i = 0; i < n; i++) {
+        int l = level[i] == -1 ? max_level + 1 : level[i];
+        order[bucket[l]++] = i;
+    }
+
+    return GRCI_OK;
+}
+
+//Relative positions for the nodes of one instance of desc.  Runs of consecutive parts of the same
+//module, like the eight Xors of a Xor8, are interleaved so node t of every part in the run sits next
+//to node t of its neighbours.  A bus sliced across such a run ends up with its bits side by side
+static grci_status grci_lane_layout(const struct grci_module_desc *desc, struct grci_arena *scratch, int *out) {
+    int off = 0;
+    int written = 0;
+    for (int i = 0; i < desc->part_count;) {
+        int j = i;
+        while (j < desc->part_count && desc->parts[j] == desc->parts[i]) {
+            j++;
+        }
+        int runs = j - i;
+        int size = desc->parts[i]->node_count;
+        int *sub;
+        grci_ensure(grci_arena_malloc(scratch, sizeof(int) * (size + 1), (void**) &sub), GRCI_ERR_MEM, 0, "placeholder");
+        grci_ensure(grci_lane_layout(desc->parts[i], scratch, sub), GRCI_ERR_MEM, 0, "placeholder");
+        for (int t = 0; t < size; t++) {
+            for (int r = 0; r < runs; r++) {
+                out[written++] = off + r * size + sub[t];
+            }
+        }
+        off += runs * size;
+        i = j;
+    }
+    for (; written < desc->node_count; written++) {
+        out[written] = written;
+    }
+    return GRCI_OK;
+}
+
+//instantiation order with replicated parts interleaved, see grci_lane_layout.  Nodes fused away are skipped
+static grci_status grci_order_lanes(const struct grci_simulator *sim, const struct grci_module_desc *desc, 
+                                    struct grci_arena *scratch, int *order) {
+    int total = sim->node_pos ? sim->node_orig_count : sim->node_count;
+    int *seq;
+    grci_ensure(grci_arena_malloc(scratch, sizeof(int) * total, (void**) &seq), GRCI_ERR_MEM, 0, "placeholder");
+    for (int i = 0; i < total; i++) {
+        seq[i] = i;
+    }
+    grci_ensure(grci_lane_layout(desc, scratch, seq + 3), GRCI_ERR_MEM, 0, "placeholder");
+    for (int i = 0; i < desc->node_count; i++) {
+        seq[3 + i] += 3;
+    }
+
+    int count = 0;
+    for (int i = 0; i < total; i++) {
+        int cur = grci_node_pos(sim, seq[i]);
+        if (cur >= 0) {
+            order[count++] = cur;
+        }
+    }
+    assert(count == sim->node_count);
+    return GRCI_OK;
+}
+
+//moves every node to pos[old index] and rewrites all references.  Nodes with a pos of -1 are dropped,
+//and nothing left may reference them
+static grci_status grci_apply_node_order(struct grci_sim *s, const int *pos) {
+    struct grci_simulator *sim = &s->sim;
+    int n = sim->node_count;
+    int kept = 0;
+    for (int i = 0; i < n; i++) {
+        kept += pos[i] >= 0;
+    }
+
+    struct grci_node *old = sim->nodes;
+    struct grci_node *nodes = sim->arena.malloc(sizeof(struct grci_node) * (kept < n ? kept : sim->node_capacity));
+    grci_ensure(nodes, GRCI_ERR_MEM, 0, "malloc failed");
+
+#define GRCI_MOVED(ptr) (&nodes[pos[(ptr) - old]])
+    for (int i = 0; i < n; i++) {
+        if (pos[i] < 0) continue;
+        struct grci_node *node = &nodes[pos[i]];
+        *node = old[i];
+        struct grci_node **slots[3];
+        int operand_count = grci_node_operands(node, slots);
+        for (int k = 0; k < operand_count; k++) {
+            assert(pos[*slots[k] - old] >= 0);
+            *slots[k] = GRCI_MOVED(*slots[k]);
+        }
+        if (node->type == GRCI_NT_DFF) {
+            node->as.dff.input = GRCI_MOVED(node->as.dff.input);
+        }
+    }
+
+    for (int r = 0; r < sim->ram_count; r++) {
+        struct grci_ram64k *ram = &sim->rams[r];
+        for (int i = 0; i < 16; i++) {
+            ram->inputs[i] = GRCI_MOVED(ram->inputs[i]);
+            ram->addrs[i] = GRCI_MOVED(ram->addrs[i]);
+            ram->outputs[i] = GRCI_MOVED(ram->outputs[i]);
+        }
+        ram->load = GRCI_MOVED(ram->load);
+    }
+
+    for (int i = 0; i < sim->dff_node_count; i++) {
+        sim->dff_nodes[i] = GRCI_MOVED(sim->dff_nodes[i]);
+    }
+    sim->const0 = GRCI_MOVED(sim->const0);
+    sim->const1 = GRCI_MOVED(sim->const1);
+    sim->clock = GRCI_MOVED(sim->clock);
+
+    for (int i = 0; i < s->module.desc->input_count; i++) {
+        s->module.inputs[i] = GRCI_MOVED(s->module.inputs[i]);
+    }
+    for (int i = 0; i < s->module.desc->output_count; i++) {
+        s->module.outputs[i] = GRCI_MOVED(s->module.outputs[i]);
+    }
+#undef GRCI_MOVED
+
+    sim->nodes = nodes;
+    sim->node_count = kept;
+    if (kept < n) {
+        sim->node_capacity = kept;
+    }
+    sim->arena.free(old);
+
+    if (!sim->node_pos) {
+        grci_ensure(grci_arena_malloc(&sim->arena, sizeof(int) * n, (void**) &sim->node_pos), GRCI_ERR_MEM, 0, "placeholder");
+        grci_ensure(grci_arena_malloc(&sim->arena, sizeof(int) * n, (void**) &sim->node_orig), GRCI_ERR_MEM, 0, "placeholder");
+        sim->node_orig_count = n;
+        for (int i = 0; i < n; i++) {
+            sim->node_pos[i] = i;
+        }
+    }
+    for (int i = 0; i < sim->node_orig_count; i++) {
+        if (sim->node_pos[i] < 0) continue;
+        sim->node_pos[i] = pos[sim->node_pos[i]];
+        if (sim->node_pos[i] >= 0) {
+            sim->node_orig[sim->node_pos[i]] = i;
+        }
+    }
+
+    if (sim->toggle_counts) {
+        uint64_t *counts = sim->arena.malloc(sizeof(uint64_t) * (kept > 0 ? kept : 1));
+        grci_ensure(counts, GRCI_ERR_MEM, 0, "malloc failed");
+        for (int i = 0; i < n; i++) {
+            if (pos[i] >= 0) {
+                counts[pos[i]] = sim->toggle_counts[i];
+            }
+        }
+        sim->arena.free(sim->toggle_counts);
+        sim->toggle_counts = counts;
+        for (int w = 0; w < grci_activity_word_count(sim); w++) {
+            sim->activity_prev[w] = grci_pack_node_word(sim, w);
+        }
+    }
+
+    return GRCI_OK;
+}
+
+grci_status grci_reorder_nodes(struct grci_module *m, enum grci_node_order order) {
+    struct grci_simulator *sim = &m->sim->sim;
+    grci_ensure(sim->foreign_count == 0, GRCI_ERR_SIM, 0, "modules with foreign parts can't be reordered");
+    grci_ensure(!m->sim->timing, GRCI_ERR_SIM, 0, "the timing engine doesn't follow reordered nodes");
+    int n = sim->node_count;
+
+    struct grci_arena scratch;
+    grci_ensure(grci_arena_init(&scratch, sim->arena.malloc, sim->arena.realloc, sim->arena.free),
+                GRCI_ERR_MEM, 0, "placeholder");
+
+    int *seq = NULL;
+    int *pos = NULL;
+    bool ok = grci_arena_malloc(&scratch, sizeof(int) * n, (void**) &seq) &&
+              grci_arena_malloc(&scratch, sizeof(int) * n, (void**) &pos);
+    switch (order) {
+    case GRCI_ORDER_LEVEL:
+        ok = ok && grci_order_level(sim, &scratch, seq);
+        break;
+    case GRCI_ORDER_RCM:
+        ok = ok && grci_order_rcm(sim, &scratch, seq);
+        break;
+    case GRCI_ORDER_LANES:
+        ok = ok && grci_order_lanes(sim, m->sim->module.desc, &scratch, seq);
+        break;
+    default:
+        ok = false;
+        break;
+    }
+
+    if (ok) {
+        for (int i = 0; i < n; i++) {
+            pos[seq[i]] = i;
+        }
+        ok = grci_apply_node_order(m->sim, pos);
+    }
+    grci_arena_cleanup(&scratch);
+
+    if (ok && m->sim->jit) {
+        ok = grci_jit_rebuild(m->sim);
+    }
+
+    grci_ensure(ok, GRCI_ERR_SIM, 0, "placeholder");
+    return GRCI_OK;
+}
+
+//Gate fusion works on the nands in level order, so every operand has its final form by the time
+//a node is looked at.  uses counts references from gates, dffs, rams and module outputs, and a
+//node may only be folded into its user when that user is the only reference
+struct grci_fuser {
+    struct grci_simulator *sim;
+    int *uses;
+    int *repl; //index of the node that replaced a removed node, or -1
+};
+
+static inline int grci_fuse_idx(struct grci_fuser *f, struct grci_node *node) {
+    return (int) (node - f->sim->nodes);
+}
+
+static inline bool grci_fuse_single(struct grci_fuser *f, struct grci_node *node, enum grci_node_type type) {
+    return node->type == type && f->uses[grci_fuse_idx(f, node)] == 1;
+}
+
+static inline struct grci_node *grci_fuse_resolve(struct grci_fuser *f, struct grci_node *node) {
+    while (f->repl[grci_fuse_idx(f, node)] != -1) {
+        node = &f->sim->nodes[f->repl[grci_fuse_idx(f, node)]];
+    }
+    return node;
+}
+
+//drops one reference, and the operands of gates that end up unreferenced
+static void grci_fuse_release(struct grci_fuser *f, struct grci_node *node) {
+    if (--f->uses[grci_fuse_idx(f, node)] > 0) return;
+    struct grci_node **slots[3];
+    int operand_count = grci_node_operands(node, slots);
+    for (int k = 0; k < operand_count; k++) {
+        grci_fuse_release(f, *slots[k]);
+    }
+}
+
+//new operands are referenced before the old ones are released so shared operands never reach zero
+static void grci_fuse_set(struct grci_fuser *f, struct grci_node *node, enum grci_node_type type,
+                          struct grci_node *a, struct grci_node *b, struct grci_node *sel) {
+    struct grci_node **slots[3];
+    struct grci_node *old[3];
+    int old_count = grci_node_operands(node, slots);
+    for (int k = 0; k < old_count; k++) {
+        old[k] = *slots[k];
+    }
+
+    node->type = type;
+    if (type == GRCI_NT_NAND) {
+        node->as.nand.a = a;
+        node->as.nand.b = b;
+    } else {
+        node->as.gate.a = a;
+        node->as.gate.b = type == GRCI_NT_NOT ? a : b;
+        node->as.gate.sel = type == GRCI_NT_MUX ? sel : a;
+    }
+    int new_count = grci_node_operands(node, slots);
+    for (int k = 0; k < new_count; k++) {
+        f->uses[grci_fuse_idx(f, *slots[k])]++;
+    }
+    for (int k = 0; k < old_count; k++) {
+        grci_fuse_release(f, old[k]);
+    }
+}
+
+//(x & !y) | (!x & y) is a xor, and (p & s) | (q & !s) is a mux.  The ands are only used by the or
+static bool grci_fuse_or(struct grci_fuser *f, struct grci_node *node) {
+    struct grci_node *l = node->as.gate.a;
+    struct grci_node *r = node->as.gate.b;
+    if (!grci_fuse_single(f, l, GRCI_NT_AND) || !grci_fuse_single(f, r, GRCI_NT_AND)) return false;
+
+    struct grci_node *ls[2] = { l->as.gate.a, l->as.gate.b };
+    struct grci_node *rs[2] = { r->as.gate.a, r->as.gate.b };
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            struct grci_node *x = ls[1 - i];
+            struct grci_node *y = rs[1 - j];
+            if (ls[i]->type == GRCI_NT_NOT && rs[j]->type == GRCI_NT_NOT &&
+                ls[i]->as.gate.a == y && rs[j]->as.gate.a == x) {
+                grci_fuse_set(f, node, GRCI_NT_XOR, x, y, NULL);
+                return true;
+            }
+            if (rs[j]->type == GRCI_NT_NOT && rs[j]->as.gate.a == ls[i]) {
+                grci_fuse_set(f, node, GRCI_NT_MUX, y, x, ls[i]);
+                return true;
+            }
+            if (ls[i]->type == GRCI_NT_NOT && ls[i]->as.gate.a == rs[j]) {
+                grci_fuse_set(f, node, GRCI_NT_MUX, x, y, rs[j]);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//nand(nand(x, !s), nand(y, s)) is a mux, and nand(nand(x, n), nand(y, n)) with n = nand(x, y) is a xor
+static bool grci_fuse_nand_pair(struct grci_fuser *f, struct grci_node *node) {
+    struct grci_node *l = node->as.nand.a;
+    struct grci_node *r = node->as.nand.b;
+    if (!grci_fuse_single(f, l, GRCI_NT_NAND) || !grci_fuse_single(f, r, GRCI_NT_NAND) || l == r) return false;
+
+    struct grci_node *ls[2] = { l->as.nand.a, l->as.nand.b };
+    struct grci_node *rs[2] = { r->as.nand.a, r->as.nand.b };
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            struct grci_node *x = ls[1 - i];
+            struct grci_node *y = rs[1 - j];
+            struct grci_node *n = ls[i];
+            if (n == rs[j] && n->type == GRCI_NT_NAND && f->uses[grci_fuse_idx(f, n)] == 2 &&
+                ((n->as.nand.a == x && n->as.nand.b == y) || (n->as.nand.a == y && n->as.nand.b == x))) {
+                grci_fuse_set(f, node, GRCI_NT_XOR, x, y, NULL);
+                return true;
+            }
+            if (ls[i]->type == GRCI_NT_NOT && ls[i]->as.gate.a == rs[j]) {
+                grci_fuse_set(f, node, GRCI_NT_MUX, x, y, rs[j]);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//rewrites one node until no pattern matches
+static void grci_fuse_node(struct grci_fuser *f, struct grci_node *node) {
+    struct grci_node **slots[3];
+    int operand_count = grci_node_operands(node, slots);
+    for (int k = 0; k < operand_count; k++) {
+        *slots[k] = grci_fuse_resolve(f, *slots[k]);
+    }
+
+    while (f->uses[grci_fuse_idx(f, node)] > 0) {
+        if (node->type == GRCI_NT_NAND) {
+            struct grci_node *a = node->as.nand.a;
+            struct grci_node *b = node->as.nand.b;
+            if (a == b) {
+                grci_fuse_set(f, node, GRCI_NT_NOT, a, NULL, NULL);
+            } else if (grci_fuse_single(f, a, GRCI_NT_NOT) && grci_fuse_single(f, b, GRCI_NT_NOT)) {
+                grci_fuse_set(f, node, GRCI_NT_OR, a->as.gate.a, b->as.gate.a, NULL);
+            } else if (!grci_fuse_nand_pair(f, node)) {
+                return;
+            }
+        } else if (node->type == GRCI_NT_NOT) {
+            struct grci_node *a = node->as.gate.a;
+            if (f->uses[grci_fuse_idx(f, a)] != 1) return;
+            switch (a->type) {
+            case GRCI_NT_NOT: {
+                //double negation, so users of node get the original signal instead
+                int idx = grci_fuse_idx(f, node);
+                struct grci_node *x = a->as.gate.a;
+                f->repl[idx] = grci_fuse_idx(f, x);
+                f->uses[grci_fuse_idx(f, x)] += f->uses[idx];
+                f->uses[idx] = 1;
+                grci_fuse_release(f, node);
+                return;
+            }
+            case GRCI_NT_NAND:
+                grci_fuse_set(f, node, GRCI_NT_AND, a->as.nand.a, a->as.nand.b, NULL);
+                break;
+            case GRCI_NT_AND:
+                grci_fuse_set(f, node, GRCI_NT_NAND, a->as.gate.a, a->as.gate.b, NULL);
+                break;
+            case GRCI_NT_XOR:
+                grci_fuse_set(f, node, GRCI_NT_XNOR, a->as.gate.a, a->as.gate.b, NULL);
+                break;
+            case GRCI_NT_XNOR:
+                grci_fuse_set(f, node, GRCI_NT_XOR, a->as.gate.a, a->as.gate.b, NULL);
+                break;
+            default:
+                return;
+            }
+        } else if (node->type != GRCI_NT_OR || !grci_fuse_or(f, node)) {
+            return;
+        }
+    }
+}
+
+//Replaces nand subgraphs whose inner nodes have no other fan-out with NOT/AND/OR/XOR/XNOR/MUX nodes
+//and removes the nodes that are no longer referenced.  Gates on combinational loops are left alone.
+//Fused modules can't be exported as netlists
+grci_status grci_fuse_gates(struct grci_module *m) {
+    struct grci_simulator *sim = &m->sim->sim;
+    grci_ensure(sim->foreign_count == 0, GRCI_ERR_SIM, 0, "modules with foreign parts can't be fused");
+    grci_ensure(!m->sim->timing, GRCI_ERR_SIM, 0, "the timing engine needs every nand");
+    struct grci_module_runtime *rt = &m->sim->module;
+    int n = sim->node_count;
+
+    struct grci_arena scratch;
+    grci_ensure(grci_arena_init(&scratch, sim->arena.malloc, sim->arena.realloc, sim->arena.free),
+                GRCI_ERR_MEM, 0, "placeholder");
+    struct grci_fuser f = { .sim = sim };
+    int *order = NULL;
+    bool *done = NULL;
+    bool ok = grci_arena_calloc(&scratch, n, sizeof(int), (void**) &f.uses) &&
+              grci_arena_malloc(&scratch, sizeof(int) * n, (void**) &f.repl) &&
+              grci_arena_malloc(&scratch, sizeof(int) * n, (void**) &order) &&
+              grci_arena_calloc(&scratch, n, sizeof(bool), (void**) &done) &&
+              grci_order_level(sim, &scratch, order);
+    if (!ok) {
+        grci_arena_cleanup(&scratch);
+        grci_ensure(false, GRCI_ERR_MEM, 0, "placeholder");
+    }
+
+    struct grci_node **slots[3];
+    for (int i = 0; i < n; i++) {
+        f.repl[i] = -1;
+        int operand_count = grci_node_operands(&sim->nodes[i], slots);
+        for (int k = 0; k < operand_count; k++) {
+            f.uses[*slots[k] - sim->nodes]++;
+        }
+        if (sim->nodes[i].type == GRCI_NT_DFF) {
+            f.uses[sim->nodes[i].as.dff.input - sim->nodes]++;
+        }
+    }
+    for (int r = 0; r < sim->ram_count; r++) {
+        for (int k = 0; k < 16; k++) {
+            f.uses[sim->rams[r].inputs[k] - sim->nodes]++;
+            f.uses[sim->rams[r].addrs[k] - sim->nodes]++;
+        }
+        f.uses[sim->rams[r].load - sim->nodes]++;
+    }
+    for (int k = 0; k < rt->desc->output_count; k++) {
+        f.uses[rt->outputs[k] - sim->nodes]++;
+    }
+
+    //gates nothing reads from can go straight away
+    for (int i = 0; i < n; i++) {
+        int operand_count = grci_node_operands(&sim->nodes[i], slots);
+        if (operand_count > 0 && f.uses[i] == 0) {
+            f.uses[i] = 1;
+            grci_fuse_release(&f, &sim->nodes[i]);
+        }
+    }
+
+    //level order puts operands first, except on loops where a gate is never ready
+    for (int j = 0; j < n; j++) {
+        int i = order[j];
+        int operand_count = grci_node_operands(&sim->nodes[i], slots);
+        bool ready = true;
+        for (int k = 0; k < operand_count; k++) {
+            ready = ready && done[grci_fuse_resolve(&f, *slots[k]) - sim->nodes];
+        }
+        done[i] = ready;
+        if (ready && operand_count > 0 && f.uses[i] > 0) {
+            grci_fuse_node(&f, &sim->nodes[i]);
+        }
+    }
+
+    //point everything at the nodes that replaced removed ones, then compact
+    for (int i = 0; i < n; i++) {
+        int operand_count = grci_node_operands(&sim->nodes[i], slots);
+        for (int k = 0; k < operand_count; k++) {
+            *slots[k] = grci_fuse_resolve(&f, *slots[k]);
+        }
+        if (sim->nodes[i].type == GRCI_NT_DFF) {
+            sim->nodes[i].as.dff.input = grci_fuse_resolve(&f, sim->nodes[i].as.dff.input);
+        }
+    }
+    for (int r = 0; r < sim->ram_count; r++) {
+        struct grci_ram64k *ram = &sim->rams[r];
+        for (int k = 0; k < 16; k++) {
+            ram->inputs[k] = grci_fuse_resolve(&f, ram->inputs[k]);
+            ram->addrs[k] = grci_fuse_resolve(&f, ram->addrs[k]);
+        }
+        ram->load = grci_fuse_resolve(&f, ram->load);
+    }
+    for (int k = 0; k < rt->desc->output_count; k++) {
+        rt->outputs[k] = grci_fuse_resolve(&f, rt->outputs[k]);
+    }
+
+    int *pos = order;
+    int kept = 0;
+    for (int i = 0; i < n; i++) {
+        bool removed = grci_node_operands(&sim->nodes[i], slots) > 0 && f.uses[i] == 0;
+        pos[i] = removed ? -1 : kept++;
+    }
+    ok = grci_apply_node_order(m->sim, pos);
+    grci_arena_cleanup(&scratch);
+    grci_ensure(ok, GRCI_ERR_SIM, 0, "placeholder");
+    sim->fused = true;
+
+    //removed nodes can't be toggled, and fused ones have their own counts from here on
+    if (sim->toggle_counts) {
+        grci_activity_disable(sim);
+        grci_ensure(grci_activity_enable(sim), GRCI_ERR_MEM, 0, "placeholder");
+    }
+    if (m->sim->jit) {
+        grci_ensure(grci_jit_rebuild(m->sim), GRCI_ERR_SIM, 0, "placeholder");
+    }
+    return GRCI_OK;
+}
+
+//Bit sliced evaluation of a combinational module: every node holds 64 input patterns in a word and
+//the gates are evaluated once per word in level order
+static inline uint64_t grci_gate_word(enum grci_node_type type, uint64_t a, uint64_t b, uint64_t sel) {
+    switch (type) {
+    case GRCI_NT_NAND: return ~(a & b);
+    case GRCI_NT_NOT:  return ~a;
+    case GRCI_NT_AND:  return a & b;
+    case GRCI_NT_OR:   return a | b;
+    case GRCI_NT_XOR:  return a ^ b;
+    case GRCI_NT_XNOR: return ~(a ^ b);
+    case GRCI_NT_MUX:  return (a & ~sel) | (b & sel);
+    default:
+        assert(false);
+        return 0;
+    }
+}
+
+//Gates of sim in level order as {node, a, b, sel}, with unused operands repeating a, so that
+//grci_word_eval can run 64 copies of the circuit at once.  Constants are set in v
+static grci_status grci_word_ops(const struct grci_simulator *sim, struct grci_arena *scratch, uint64_t *v, int **ops, int *op_count) {
+    int n = sim->node_count;
+    int *order;
+    bool *done;
+    bool ok = grci_arena_malloc(scratch, sizeof(int) * n, (void**) &order) &&
+              grci_arena_malloc(scratch, sizeof(int) * 4 * n, (void**) ops) &&
+              grci_arena_calloc(scratch, n, sizeof(bool), (void**) &done) &&
+              grci_order_level(sim, scratch, order);
+    grci_ensure(ok, GRCI_ERR_MEM, 0, "placeholder");
+
+    *op_count = 0;
+    bool loop = false;
+    for (int j = 0; j < n; j++) {
+        int i = order[j];
+        struct grci_node **slots[3];
+        int operand_count = grci_node_operands(&sim->nodes[i], slots);
+        done[i] = true;
+        for (int k = 0; k < operand_count; k++) {
+            done[i] = done[i] && done[*slots[k] - sim->nodes];
+        }
+        loop = loop || !done[i];
+        if (operand_count > 0) {
+            int *op = &(*ops)[(*op_count)++ * 4];
+            op[0] = i;
+            for (int k = 0; k < 3; k++) {
+                op[1 + k] = (int) (*slots[k < operand_count ? k : 0] - sim->nodes);
+            }
+        } else if (sim->nodes[i].type == GRCI_NT_CONSTANT) {
+            v[i] = sim->nodes[i].as.constant ? ~(uint64_t) 0 : 0;
+        }
+    }
+    grci_ensure(!loop, GRCI_ERR_SIM, 0, "word evaluation can't handle combinational loops");
+    return GRCI_OK;
+}
+
+static void grci_word_eval(const struct grci_simulator *sim, const int *ops, int op_count, uint64_t *v) {
+    for (const int *op = ops; op < ops + op_count * 4; op += 4) {
+        v[op[0]] = grci_gate_word(sim->nodes[op[0]].type, v[op[1]], v[op[2]], v[op[3]]);
+    }
+}
+
+//either fills table (see grci_truth_table) or compares every pattern against reference
+static grci_status grci_truth_run(struct grci_module *m, uint64_t *table, size_t word_count, grci_truth_fn reference, void *user) {
+    struct grci_simulator *sim = &m->sim->sim;
+    const struct grci_module_runtime *rt = &m->sim->module;
+    int input_count = rt->desc->input_count;
+    int output_count = rt->desc->output_count;
+    grci_ensure(sim->dff_node_count == 0, GRCI_ERR_SIM, 0, "truth tables need a combinational module, this one has %d dffs", sim->dff_node_count);
+    grci_ensure(sim->foreign_count == 0, GRCI_ERR_SIM, 0, "truth tables can't see into foreign parts");
+    grci_ensure(input_count <= GRCI_TRUTH_MAX_INPUTS, GRCI_ERR_SIM, 0, "truth tables are limited to %d inputs", GRCI_TRUTH_MAX_INPUTS);
+
+    uint64_t pattern_count = (uint64_t) 1 << input_count;
+    size_t words = (size_t) ((pattern_count + 63) / 64);
+    if (table) {
+        grci_ensure(word_count >= words * output_count, GRCI_ERR_SIM, 0, "truth table needs %zu words", words * output_count);
+    } else {
+        grci_ensure(output_count <= 64, GRCI_ERR_SIM, 0, "reference functions are limited to 64 outputs");
+    }
+
+    struct grci_arena scratch;
+    grci_ensure(grci_arena_init(&scratch, sim->arena.malloc, sim->arena.realloc, sim->arena.free), GRCI_ERR_MEM, 0, "placeholder");
+    int *ops;
+    int op_count;
+    uint64_t *v;
+    if (!grci_arena_calloc(&scratch, sim->node_count, sizeof(uint64_t), (void**) &v) ||
+        !grci_word_ops(sim, &scratch, v, &ops, &op_count)) {
+        grci_arena_cleanup(&scratch);
+        return GRCI_ERR;
+    }
+
+    //the low six inputs vary within a word, the rest are the same across it
+    static const uint64_t low_inputs[6] = { 0xaaaaaaaaaaaaaaaaull, 0xccccccccccccccccull, 0xf0f0f0f0f0f0f0f0ull,
+                                            0xff00ff00ff00ff00ull, 0xffff0000ffff0000ull, 0xffffffff00000000ull };
+    uint64_t lanes = pattern_count < 64 ? pattern_count : 64;
+    for (size_t w = 0; w < words; w++) {
+        for (int i = 0; i < input_count; i++) {
+            uint64_t bits = i < 6 ? low_inputs[i] : ((w >> (i - 6)) & 1 ? ~(uint64_t) 0 : 0);
+            v[rt->inputs[i] - sim->nodes] = bits;
+        }
+        grci_word_eval(sim, ops, op_count, v);
+
+        if (table) {
+            uint64_t mask = lanes == 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << lanes) - 1;
+            for (int k = 0; k < output_count; k++) {
+                table[k * words + w] = v[rt->outputs[k] - sim->nodes] & mask;
+            }
+            continue;
+        }
+        for (uint64_t l = 0; l < lanes; l++) {
+            uint64_t inputs = w * 64 + l;
+            uint64_t expected = reference(inputs, user);
+            uint64_t actual = 0;
+            for (int k = 0; k < output_count; k++) {
+                actual |= ((v[rt->outputs[k] - sim->nodes] >> l) & 1) << k;
+            }
+            if (actual != expected) {
+                grci_arena_cleanup(&scratch);
+                grci_ensure(false, GRCI_ERR_SIM, 0, "inputs 0x%llx give outputs 0x%llx, expected 0x%llx",
+                            (unsigned long long) inputs, (unsigned long long) actual, (unsigned long long) expected);
+            }
+        }
+    }
+
+    grci_arena_cleanup(&scratch);
+    return GRCI_OK;
+}
+
+//Every output gets (2^inputs + 63) / 64 consecutive words.  Bit p of an output's words is its value for
+//input pattern p, where input i is bit i of p
+grci_status grci_truth_table(struct grci_module *m, uint64_t *table, size_t word_count) {
+    return grci_truth_run(m, table, word_count, NULL, NULL);
+}
+
+//reference gets the input pattern as above and returns the expected outputs with output k in bit k.
+//Fails on the first pattern that differs
+grci_status grci_check_truth_table(struct grci_module *m, grci_truth_fn reference, void *user) {
+    return grci_truth_run(m, NULL, 0, reference, user);
+}
+
+//64 copies of a sequential module, one per bit of each node's word
+struct grci_word_sim {
+    struct grci_module *m;
+    uint64_t *v;
+    int *ops;
+    int op_count;
+    uint64_t *next; //dff inputs latched on the clock edge
+    int *states; //positions of the compared dffs
+    int state_count;
+    bool clock_used;
+};
+
+static grci_status grci_word_sim_init(struct grci_word_sim *w, struct grci_module *m, struct grci_arena *scratch, 
+                                      const char *state_name, size_t state_len) {
+    struct grci_simulator *sim = &m->sim->sim;
+    w->m = m;
+    w->state_count = 0;
+    bool ok = grci_arena_calloc(scratch, sim->node_count, sizeof(uint64_t), (void**) &w->v) &&
+              grci_arena_malloc(scratch, sizeof(uint64_t) * (sim->dff_node_count + 1), (void**) &w->next) &&
+              grci_arena_malloc(scratch, sizeof(int) * (sim->dff_node_count + 1), (void**) &w->states);
+    grci_ensure(ok, GRCI_ERR_MEM, 0, "placeholder");
+    if (!grci_word_ops(sim, scratch, w->v, &w->ops, &w->op_count)) return GRCI_ERR;
+
+    int clock = (int) (sim->clock - sim->nodes);
+    w->clock_used = false;
+    for (int k = 0; k < w->op_count * 4; k++) {
+        w->clock_used = w->clock_used || (k % 4 != 0 && w->ops[k] == clock);
+    }
+
+    if (state_name) {
+        int off, count;
+        if (!grci_part_node_range(m->sim->module.desc, state_name, state_len, &off, &count, NULL)) return GRCI_ERR;
+        for (int idx = off; idx < off + count; idx++) {
+            int pos = grci_node_pos(sim, idx);
+            if (pos != -1 && sim->nodes[pos].type == GRCI_NT_DFF) {
+                w->states[w->state_count++] = pos;
+            }
+        }
+    }
+    return GRCI_OK;
+}
+
+static void grci_word_sim_latch(struct grci_word_sim *w) {
+    struct grci_simulator *sim = &w->m->sim->sim;
+    for (int k = 0; k < sim->dff_node_count; k++) {
+        w->next[k] = w->v[sim->dff_nodes[k]->as.dff.input - sim->nodes];
+    }
+    for (int k = 0; k < sim->dff_node_count; k++) {
+        w->v[sim->dff_nodes[k] - sim->nodes] = w->next[k];
+    }
+}
+
+static inline uint64_t grci_word_sim_output(const struct grci_word_sim *w, int k) {
+    return w->v[w->m->sim->module.outputs[k] - w->m->sim->sim.nodes];
+}
+
+//lanes that differ in any output, or in the compared state after a rising edge
+static uint64_t grci_word_sim_diff(const struct grci_word_sim *w, bool states, int *first) {
+    uint64_t diff = 0;
+    int count = states ? w[0].state_count : w[0].m->output_count;
+    for (int k = count - 1; k >= 0; k--) {
+        uint64_t d = states ? w[0].v[w[0].states[k]] ^ w[1].v[w[1].states[k]] : grci_word_sim_output(&w[0], k) ^ grci_word_sim_output(&w[1], k);
+        if (d) {
+            *first = k;
+        }
+        diff |= d;
+    }
+    return diff;
+}
+
+static grci_status grci_equivalent_run(struct grci_module **mods, uint64_t cycles, uint64_t seed, 
+                                       const char *state_name, size_t state_len, struct grci_divergence *divergence) {
+    struct grci_arena scratch;
+    struct grci_simulator *sim0 = &mods[0]->sim->sim;
+    grci_ensure(grci_arena_init(&scratch, sim0->arena.malloc, sim0->arena.realloc, sim0->arena.free), GRCI_ERR_MEM, 0, "placeholder");
+
+    int input_count = mods[0]->input_count;
+    struct grci_word_sim w[2];
+    uint64_t *in;
+    bool ok = grci_arena_malloc(&scratch, sizeof(uint64_t) * (input_count + 1), (void**) &in) &&
+              grci_word_sim_init(&w[0], mods[0], &scratch, state_name, state_len) &&
+              grci_word_sim_init(&w[1], mods[1], &scratch, state_name, state_len);
+    if (ok && w[0].state_count != w[1].state_count) {
+        grci_arena_cleanup(&scratch);
+        grci_ensure(false, GRCI_ERR_SIM, 0, "%.*s has %d dffs in one module and %d in the other", 
+                    (int) state_len, state_name, w[0].state_count, w[1].state_count);
+    }
+    if (!ok) {
+        grci_arena_cleanup(&scratch);
+        return GRCI_ERR;
+    }
+
+    //a cycle is a low step followed by a high one, with the inputs drawn once for both
+    uint64_t rng = seed;
+    uint64_t diff = 0;
+    uint64_t step = 0;
+    int first = 0;
+    bool states = false;
+    for (uint64_t c = 0; c < cycles && !diff; c++) {
+        for (int i = 0; i < input_count; i++) {
+            in[i] = grci_splitmix64(&rng);
+        }
+        for (int s = 0; s < 2; s++) {
+            struct grci_simulator *sim = &w[s].m->sim->sim;
+            for (int i = 0; i < input_count; i++) {
+                w[s].v[w[s].m->sim->module.inputs[i] - sim->nodes] = in[i];
+            }
+            w[s].v[sim->clock - sim->nodes] = 0;
+            grci_word_eval(sim, w[s].ops, w[s].op_count, w[s].v);
+        }
+        step = c * 2;
+        diff = grci_word_sim_diff(w, false, &first);
+        if (diff) break;
+
+        for (int s = 0; s < 2; s++) {
+            struct grci_simulator *sim = &w[s].m->sim->sim;
+            w[s].v[sim->clock - sim->nodes] = ~(uint64_t) 0;
+            //dff inputs only need recomputing if the clock reaches them
+            if (w[s].clock_used) {
+                grci_word_eval(sim, w[s].ops, w[s].op_count, w[s].v);
+            }
+            grci_word_sim_latch(&w[s]);
+            grci_word_eval(sim, w[s].ops, w[s].op_count, w[s].v);
+        }
+        step = c * 2 + 1;
+        diff = grci_word_sim_diff(w, false, &first);
+        if (!diff) {
+            diff = grci_word_sim_diff(w, true, &first);
+            states = diff != 0;
+        }
+    }
+
+    if (diff && divergence) {
+        int lane = grci_ctz64(diff);
+        divergence->step = step;
+        divergence->lane = lane;
+        divergence->output = states ? -1 : first;
+        divergence->state = states ? first : -1;
+        for (int i = 0; divergence->inputs && i < input_count; i++) {
+            divergence->inputs[i] = (in[i] >> lane) & 1;
+        }
+    }
+    grci_arena_cleanup(&scratch);
+    grci_ensure(!diff, GRCI_ERR_SIM, 0, "modules differ at %s %d on step %llu", states ? "state" : "output", first, (unsigned long long) step);
+    return GRCI_OK;
+}
+
+//Runs both modules from power on in 64 lanes at once, each lane driven with its own random inputs that stay
+//the same for the two steps of a cycle.  Every input draws one word per cycle from splitmix64 seeded with
+//seed, in input order, and bit l of that word goes to lane l.  Outputs are compared after every step, and
+//the dffs under state_name, if given, after every rising edge.  Modules with Ram64K parts aren't supported
+grci_status grci_check_equivalent(struct grci *g, const char *name_a, size_t len_a, const char *name_b, size_t len_b, uint64_t cycles, 
+                                  uint64_t seed, const char *state_name, size_t state_len, struct grci_divergence *divergence) {
+    struct grci_string names[2] = { { .ptr = name_a, .len = len_a }, { .ptr = name_b, .len = len_b } };
+    const struct grci_module_desc *descs[2];
+    for (int s = 0; s < 2; s++) {
+        descs[s] = grci_module_desc_list_get(&g->compiler.module_defs, &names[s]);
+        grci_ensure(descs[s], GRCI_ERR_SIM, 0, "module %.*s does not exist", (int) names[s].len, names[s].ptr);
+        grci_ensure(descs[s]->ram_count == 0, GRCI_ERR_SIM, 0, "equivalence checking doesn't support Ram64K, %.*s has %d", 
+                    (int) names[s].len, names[s].ptr, descs[s]->ram_count);
+        grci_ensure(descs[s]->foreign_count == 0, GRCI_ERR_SIM, 0, "equivalence checking doesn't support foreign parts, %.*s has %d", 
+                    (int) names[s].len, names[s].ptr, descs[s]->foreign_count);
+    }
+    bool same = descs[0]->input_param_count == descs[1]->input_param_count && 
+                descs[0]->output_param_count == descs[1]->output_param_count;
+    for (int i = 0; same && i < descs[0]->input_param_count; i++) {
+        same = descs[0]->input_widths[i] == descs[1]->input_widths[i];
+    }
+    for (int i = 0; same && i < descs[0]->output_param_count; i++) {
+        same = descs[0]->output_widths[i] == descs[1]->output_widths[i];
+    }
+    grci_ensure(same, GRCI_ERR_SIM, 0, "%.*s and %.*s have different inputs or outputs", (int) len_a, name_a, (int) len_b, name_b);
+
+    if (divergence) {
+        divergence->lane = -1;
+    }
+    //fusing doesn't change behaviour and makes the word evaluation several times faster
+    struct grci_module *mods[2] = { grci_init_module(g, name_a, len_a), NULL };
+    mods[1] = mods[0] ? grci_init_module(g, name_b, len_b) : NULL;
+    bool ok = mods[1] && grci_fuse_gates(mods[0]) && grci_fuse_gates(mods[1]) && 
+              grci_equivalent_run(mods, cycles, seed, state_name, state_len, divergence);
+    for (int s = 0; s < 2; s++) {
+        if (mods[s]) grci_destroy_module(mods[s]);
+    }
+    return ok;
+}
+
+static void grci_free_module(struct grci_module *m) {
+    grci_checkpoints_clear(m->sim);
+    grci_journal_clear(m->sim);
+    grci_set_capture(m, NULL);
+    if (m->sim->power_on.bits) {
+        grci_checkpoint_free(m->sim, &m->sim->power_on);
+    }
+    grci_jit_free(&m->sim->sim, m->sim->jit);
+    grci_timing_free(&m->sim->sim, m->sim->timing);
+    grci_simulator_cleanup(&m->sim->sim);
+    void (*free)(void*) = m->sim->g->client_free;
+    free(m->sim);
+    free(m);
+}
+
+//Only instances built by grci_init_module and not restructured since are pooled, so that one taken from
+//the pool can't be told apart from a new one
+static bool grci_poolable(struct grci_module *m) {
+    struct grci *g = m->sim->g;
+    int idx = grci_pool_index(g, m->sim->module.desc);
+    return idx != -1 && !m->sim->sim.node_pos && !m->sim->sim.fused && g->pool_counts[idx] < g->pool_limit;
+}
+
+void grci_destroy_module(struct grci_module *m) {
+    struct grci_sim *s = m->sim;
+    grci_unlink(m);
+    if (!grci_poolable(m)) {
+        grci_free_module(m);
+        return;
+    }
+
+    grci_checkpoints_clear(s);
+    grci_journal_clear(s);
+    grci_set_capture(m, NULL);
+    grci_activity_disable(&s->sim);
+    if (s->power_on.bits) {
+        grci_checkpoint_free(s, &s->power_on);
+        s->power_on.bits = NULL;
+    }
+    grci_jit_free(&s->sim, s->jit);
+    s->jit = NULL;
+    grci_timing_free(&s->sim, s->timing);
+    s->timing = NULL;
+    s->engine_reason[0] = '\0';
+    grci_reset_module(m);
+
+    struct grci *g = s->g;
+    int idx = grci_pool_index(g, s->module.desc);
+    s->pool_next = g->pool[idx];
+    g->pool[idx] = m;
+    g->pool_counts[idx]++;
+}
+
+//Keeps up to limit destroyed instances of each module for grci_init_module to hand out again.  Instances
+//over the new limit are freed, and grci_cleanup frees the rest
+void grci_set_pool(struct grci *g, int limit) {
+    g->pool_limit = limit > 0 ? limit : 0;
+    for (int i = 0; i < GRCI_MAX_MODULES; i++) {
+        while (g->pool_counts[i] > g->pool_limit) {
+            struct grci_module *m = g->pool[i];
+            g->pool[i] = m->sim->pool_next;
+            g->pool_counts[i]--;
+            grci_free_module(m);
+        }
+    }
+}
+void grci_cleanup(struct grci *g) {
+    grci_set_pool(g, 0);
+    g->client_free(g);
+}
+
+const char *grci_err(void) {
+    return grci_err_buf;
+}
+
+void grci_set_input(struct grci_module *m, int idx, bool value) {
+    m->inputs[idx] = value;
+}
+
+bool grci_get_output(struct grci_module *m, int idx) {
+    return m->outputs[idx];
+}
+void grci_set_state(struct grci_submodule *m, int idx, bool value) {
+    m->states[idx] = value;
+}
+bool grci_get_state(struct grci_submodule *m, int idx) {
+    return m->states[idx];
+}
+
+/*
+ * Netlist
+ *
+ * Flat gate level netlist of an instantiated module.  Every integer is an unsigned LEB128 varint
+ * and every node reference is an index into the node list:
+ *
+ *   "GRCN" version name_len name
+ *   input_count output_count node_count dff_count ram_count part_count
+ *   const0 const1 clock
+ *   nodes:   type, followed by CONSTANT value | NAND a b | DFF input | RAM64KOUT ram bit
+ *   rams:    inputs[16] load addrs[16]
+ *   dffs:    dff node references in update order
+ *   inputs:  module input nodes
+ *   outputs: module output nodes
+ *   parts:   name_len name type_len type node_count dff_off dff_len
+ */
+
+#define GRCI_NETLIST_VERSION 1
+
+struct grci_buffer {
+    unsigned char *data;
+    size_t count;
+    size_t capacity;
+    void* (*realloc)(void*, size_t);
+};
+
+static grci_status grci_buffer_put(struct grci_buffer *b, const void *data, size_t len) {
+    if (b->count + len > b->capacity) {
+        size_t capacity = b->capacity == 0 ? GRCI_DEFAULT_CHUNK_SIZE : b->capacity;
+        while (capacity < b->count + len) {
+            capacity *= 2;
+        }
+        unsigned char *new_data = b->realloc(b->data, capacity);
+        grci_ensure(new_data, GRCI_ERR_MEM, 0, "realloc failed");
+        b->data = new_data;
+        b->capacity = capacity;
+    }
+
+    memcpy(b->data + b->count, data, len);
+    b->count += len;
+    return GRCI_OK;
+}
+
+static grci_status grci_buffer_put_varint(struct grci_buffer *b, uint64_t value) {
+    unsigned char bytes[10];
+    int count = 0;
+    do {
+        bytes[count] = value & 0x7f;
+        value >>= 7;
+        if (value) bytes[count] |= 0x80;
+        count++;
+    } while (value);
+
+    return grci_buffer_put(b, bytes, count);
+}
+
+static grci_status grci_buffer_put_string(struct grci_buffer *b, const struct grci_string *s) {
+    grci_ensure(grci_buffer_put_varint(b, s->ptr ? s->len : 0), GRCI_ERR_MEM, 0, "placeholder");
+    if (s->ptr) {
+        grci_ensure(grci_buffer_put(b, s->ptr, s->len), GRCI_ERR_MEM, 0, "placeholder");
+    }
+    return GRCI_OK;
+}
+
+struct grci_reader {
+    const unsigned char *data;
+    size_t count;
+    size_t off;
+};
+
+static grci_status grci_read_varint(struct grci_reader *r, uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        grci_ensure(r->off < r->count, GRCI_ERR_IO, 0, "netlist is truncated");
+        unsigned char c = r->data[r->off];
+        r->off++;
+        *value |= (uint64_t) (c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            return GRCI_OK;
+        }
+    }
+
+    grci_ensure(false, GRCI_ERR_IO, 0, "netlist varint is too long");
+    return GRCI_ERR;
+}
+
+//reads a varint that must be smaller than 'limit'
+static grci_status grci_read_int(struct grci_reader *r, int limit, int *value) {
+    uint64_t v;
+    grci_ensure(grci_read_varint(r, &v), GRCI_ERR_IO, 0, "placeholder");
+    grci_ensure(v < (uint64_t) limit, GRCI_ERR_IO, 0, "netlist value %llu out of range (limit %d)", (unsigned long long) v, limit);
+    *value = (int) v;
+    return GRCI_OK;
+}
+
+static grci_status grci_read_node(struct grci_reader *r, struct grci_simulator *sim, int node_count, struct grci_node **node) {
+    int idx;
+    grci_ensure(grci_read_int(r, node_count, &idx), GRCI_ERR_IO, 0, "placeholder");
+    *node = &sim->nodes[idx];
+    return GRCI_OK;
+}
+
+static grci_status grci_read_string(struct grci_reader *r, struct grci_arena *arena, struct grci_string *s) {
+    int len;
+    grci_ensure(grci_read_int(r, 4096, &len), GRCI_ERR_IO, 0, "placeholder");
+    grci_ensure(r->off + len <= r->count, GRCI_ERR_IO, 0, "netlist is truncated");
+    s->ptr = NULL;
+    s->len = 0;
+    if (len > 0) {
+        grci_ensure(grci_string_alloc(arena, (const char*) r->data + r->off, len, s), GRCI_ERR_MEM, 0, "placeholder");
+    }
+    r->off += len;
+    return GRCI_OK;
+}
+
+//netlists always use instantiation order so part node ranges stay valid after reordering
+static inline int grci_node_idx(const struct grci_simulator *sim, const struct grci_node *node) {
+    int idx = (int) (node - sim->nodes);
+    return sim->node_orig ? sim->node_orig[idx] : idx;
+}
+
+//instantiation leaves unconnected outputs dangling, so references are checked before writing them out
+static grci_status grci_buffer_put_node(struct grci_buffer *b, const struct grci_simulator *sim, const struct grci_node *node) {
+    bool valid = node >= sim->nodes && node < sim->nodes + sim->node_count &&
+                 ((const char*) node - (const char*) sim->nodes) % sizeof(struct grci_node) == 0;
+    grci_ensure(valid, GRCI_ERR_SIM, 0, "netlist references an unconnected node");
+    return grci_buffer_put_varint(b, grci_node_idx(sim, node));
+}
+
+static grci_status grci_write_netlist(struct grci_sim *s, struct grci_buffer *b) {
+    struct grci_simulator *sim = &s->sim;
+    int ram_count = sim->ram_count;
+    const struct grci_module_desc *desc = s->module.desc;
+
+    //part node ranges in the file are only valid for an unfused netlist
+    grci_ensure(!sim->fused, GRCI_ERR_SIM, 0, "modules with fused gates can't be exported");
+    grci_ensure(sim->foreign_count == 0, GRCI_ERR_SIM, 0, "modules with foreign parts can't be exported");
+
+    grci_ensure(grci_buffer_put(b, "GRCN", 4), GRCI_ERR_MEM, 0, "placeholder");
+    grci_ensure(grci_buffer_put_varint(b, GRCI_NETLIST_VERSION), GRCI_ERR_MEM, 0, "placeholder");
+    grci_ensure(grci_buffer_put_string(b, &desc->name), GRCI_ERR_MEM, 0, "placeholder");
+
+    const int header[] = { desc->input_count, desc->output_count, sim->node_count, sim->dff_node_count, ram_count, desc->part_count,
+                           grci_node_idx(sim, sim->const0), grci_node_idx(sim, sim->const1), grci_node_idx(sim, sim->clock) };
+    for (int i = 0; i < (int) (sizeof(header) / sizeof(header[0])); i++) {
+        grci_ensure(grci_buffer_put_varint(b, header[i]), GRCI_ERR_MEM, 0, "placeholder");
+    }
+
+    for (int i = 0; i < sim->node_count; i++) {
+        struct grci_node *n = &sim->nodes[grci_node_pos(sim, i)];
+        grci_ensure(grci_buffer_put_varint(b, n->type), GRCI_ERR_MEM, 0, "placeholder");
+        switch (n->type) {
+        case GRCI_NT_CONSTANT:
+            grci_ensure(grci_buffer_put_varint(b, n->as.constant), GRCI_ERR_MEM, 0, "placeholder");
+            break;
+        case GRCI_NT_NAND:
+            grci_ensure(grci_buffer_put_node(b, sim, n->as.nand.a), GRCI_ERR_MEM, 0, "placeholder");
+            grci_ensure(grci_buffer_put_node(b, sim, n->as.nand.b), GRCI_ERR_MEM, 0, "placeholder");
+            break;
+        case GRCI_NT_DFF:
+            grci_ensure(grci_buffer_put_node(b, sim, n->as.dff.input), GRCI_ERR_MEM, 0, "placeholder");
+            break;
+        case GRCI_NT_RAM64KOUT: {
+            struct grci_ram64k *ram = n->as.ram64Kout.ram;
+            int bit = 0;
+            while (ram->outputs[bit] != n) {
+                bit++;
+            }
+            grci_ensure(grci_buffer_put_varint(b, (int) (ram - sim->rams)), GRCI_ERR_MEM, 0, "placeholder");
+            grci_ensure(grci_buffer_put_varint(b, bit), GRCI_ERR_MEM, 0, "placeholder");
+            break;
+        }
+        default:
+            grci_ensure(false, GRCI_ERR_INTERN, 0, "node type %d can't be exported", n->type);
+            break;
+        }
+    }
+
+    for (int i = 0; i < ram_count; i++) {
+        struct grci_ram64k *ram = &sim->rams[i];
+        for (int j = 0; j < 16; j++) {
+            grci_ensure(grci_buffer_put_node(b, sim, ram->inputs[j]), GRCI_ERR_MEM, 0, "placeholder");
+        }
+        grci_ensure(grci_buffer_put_node(b, sim, ram->load), GRCI_ERR_MEM, 0, "placeholder");
+        for (int j = 0; j < 16; j++) {
+            grci_ensure(grci_buffer_put_node(b, sim, ram->addrs[j]), GRCI_ERR_MEM, 0, "placeholder");
+        }
+    }
+
+    for (int i = 0; i < sim->dff_node_count; i++) {
+        grci_ensure(grci_buffer_put_node(b, sim, sim->dff_nodes[i]), GRCI_ERR_MEM, 0, "placeholder");
+    }
+    for (int i = 0; i < desc->input_count; i++) {
+        grci_ensure(grci_buffer_put_node(b, sim, s->module.inputs[i]), GRCI_ERR_MEM, 0, "placeholder");
+    }
+    for (int i = 0; i < desc->output_count; i++) {
+        grci_ensure(grci_buffer_put_node(b, sim, s->module.outputs[i]), GRCI_ERR_MEM, 0, "placeholder");
+    }
+
+    for (int i = 0; i < desc->part_count; i++) {
+        grci_ensure(grci_buffer_put_string(b, &desc->part_names[i]), GRCI_ERR_MEM, 0, "placeholder");
+        grci_ensure(grci_buffer_put_string(b, &desc->parts[i]->name), GRCI_ERR_MEM, 0, "placeholder");
+        grci_ensure(grci_buffer_put_varint(b, desc->parts[i]->node_count), GRCI_ERR_MEM, 0, "placeholder");
+        grci_ensure(grci_buffer_put_varint(b, s->module.dff_off_len[i][0]), GRCI_ERR_MEM, 0, "placeholder");
+        grci_ensure(grci_buffer_put_varint(b, s->module.dff_off_len[i][1]), GRCI_ERR_MEM, 0, "placeholder");
+    }
+
+    return GRCI_OK;
+}
+
+static grci_status grci_read_netlist(struct grci *g, struct grci_sim *s, struct grci_reader *r) {
+    grci_ensure(r->count >= 4 && memcmp(r->data, "GRCN", 4) == 0, GRCI_ERR_IO, 0, "not a grci netlist");
+    r->off = 4;
+
+    int version;
+    grci_ensure(grci_read_int(r, GRCI_NETLIST_VERSION + 1, &version), GRCI_ERR_IO, 0, "placeholder");
+    grci_ensure(version == GRCI_NETLIST_VERSION, GRCI_ERR_IO, 0, "unsupported netlist version %d", version);
+
+    struct grci_string name;
+    struct grci_arena scratch; //name is read before the simulator arena exists
+    grci_ensure(grci_arena_init(&scratch, g->client_malloc, g->client_realloc, g->client_free), GRCI_ERR_MEM, 0, "placeholder");
+    bool ok = grci_read_string(r, &scratch, &name);
+
+    int input_count, output_count, node_count, dff_count, ram_count, part_count;
+    ok = ok && grci_read_int(r, GRCI_MAX_INPUTS + 1, &input_count);
+    ok = ok && grci_read_int(r, GRCI_MAX_OUTPUTS + 1, &output_count);
+    ok = ok && grci_read_int(r, INT32_MAX, &node_count);
+    ok = ok && grci_read_int(r, node_count + 1, &dff_count);
+    ok = ok && grci_read_int(r, node_count / 16 + 1, &ram_count);
+    ok = ok && grci_read_int(r, GRCI_MAX_PARTS + 1, &part_count);
+    if (!ok) {
+        grci_arena_cleanup(&scratch);
+        return GRCI_ERR;
+    }
+    //every node is at least two bytes in the file, so this catches absurd counts before allocating
+    if (node_count < 3 + input_count || (size_t) node_count > r->count) {
+        grci_arena_cleanup(&scratch);
+        grci_ensure(false, GRCI_ERR_IO, 0, "invalid netlist node count %d", node_count);
+    }
+    if (g->limits.max_nodes > 0 && node_count > g->limits.max_nodes) {
+        grci_arena_cleanup(&scratch);
+        grci_ensure(false, GRCI_ERR_SIM, 0, "netlist has %d nodes, the limit is %d", node_count, g->limits.max_nodes);
+    }
+
+    struct grci_simulator *sim = &s->sim;
+    ok = grci_simulator_alloc(sim, g->client_malloc, g->client_realloc, g->client_free, node_count, dff_count, ram_count) == GRCI_OK;
+    sim->node_count = node_count;
+    sim->ram_count = ram_count;
+    ok = ok && grci_string_alloc(&sim->arena, name.ptr ? name.ptr : "Netlist", name.ptr ? name.len : 7, &name);
+    grci_arena_cleanup(&scratch);
+    grci_ensure(ok, GRCI_ERR_MEM, 0, "malloc failed");
+
+    grci_ensure(grci_read_node(r, sim, node_count, &sim->const0), GRCI_ERR_IO, 0, "placeholder");
+    grci_ensure(grci_read_node(r, sim, node_count, &sim->const1), GRCI_ERR_IO, 0, "placeholder");
+    grci_ensure(grci_read_node(r, sim, node_count, &sim->clock), GRCI_ERR_IO, 0, "placeholder");
+
+    struct grci_ram64k *rams = sim->rams;
+
+    int state_count = 0; //dffs and ram outputs, each of which must be in the dff list
+    for (int i = 0; i < node_count; i++) {
+        struct grci_node *n = &sim->nodes[i];
+        int type;
+        grci_ensure(grci_read_int(r, GRCI_NT_RAM64KOUT + 1, &type), GRCI_ERR_IO, 0, "placeholder");
+        n->type = type;
+        n->visited = false;
+        n->cached_state = false;
+        switch (n->type) {
+        case GRCI_NT_CONSTANT: {
+            int value;
+            grci_ensure(grci_read_int(r, 2, &value), GRCI_ERR_IO, 0, "placeholder");
+            n->as.constant = value;
+            n->cached_state = value;
+            break;
+        }
+        case GRCI_NT_NAND:
+            grci_ensure(grci_read_node(r, sim, node_count, &n->as.nand.a), GRCI_ERR_IO, 0, "placeholder");
+            grci_ensure(grci_read_node(r, sim, node_count, &n->as.nand.b), GRCI_ERR_IO, 0, "placeholder");
+            break;
+        case GRCI_NT_DFF:
+            grci_ensure(grci_read_node(r, sim, node_count, &n->as.dff.input), GRCI_ERR_IO, 0, "placeholder");
+            n->as.dff.last_state = false;
+            state_count++;
+            break;
+        case GRCI_NT_RAM64KOUT: {
+            int ram_idx, bit;
+            grci_ensure(grci_read_int(r, ram_count, &ram_idx), GRCI_ERR_IO, 0, "placeholder");
+            grci_ensure(grci_read_int(r, 16, &bit), GRCI_ERR_IO, 0, "placeholder");
+            grci_ensure(!rams[ram_idx].outputs[bit], GRCI_ERR_IO, 0, "ram %d output %d is defined twice", ram_idx, bit);
+            rams[ram_idx].outputs[bit] = n;
+            n->as.ram64Kout.ram = &rams[ram_idx];
+            n->as.ram64Kout.last_state = false;
+            state_count++;
+            break;
+        }
+        default:
+            assert(false);
+            break;
+        }
+    }
+
+    for (int i = 0; i < ram_count; i++) {
+        struct grci_ram64k *ram = &rams[i];
+        for (int j = 0; j < 16; j++) {
+            grci_ensure(ram->outputs[j], GRCI_ERR_IO, 0, "ram %d is missing output %d", i, j);
+            grci_ensure(grci_read_node(r, sim, node_count, &ram->inputs[j]), GRCI_ERR_IO, 0, "placeholder");
+        }
+        grci_ensure(grci_read_node(r, sim, node_count, &ram->load), GRCI_ERR_IO, 0, "placeholder");
+        for (int j = 0; j < 16; j++) {
+            grci_ensure(grci_read_node(r, sim, node_count, &ram->addrs[j]), GRCI_ERR_IO, 0, "placeholder");
+        }
+    }
+
+    //a dff left out of the list would never update, so the list must hold every one exactly once
+    grci_ensure(state_count == dff_count, GRCI_ERR_IO, 0, "netlist has %d dffs but lists %d", state_count, dff_count);
+    for (int i = 0; i < dff_count; i++) {
+        struct grci_node *n;
+        grci_ensure(grci_read_node(r, sim, node_count, &n), GRCI_ERR_IO, 0, "placeholder");
+        grci_ensure(n->type == GRCI_NT_DFF || n->type == GRCI_NT_RAM64KOUT, GRCI_ERR_IO, 0, "dff list references a combinational node");
+        grci_ensure(!n->visited, GRCI_ERR_IO, 0, "dff list references node %d twice", (int) (n - sim->nodes));
+        n->visited = true;
+        sim->dff_nodes[i] = n;
+    }
+    for (int i = 0; i < dff_count; i++) {
+        sim->dff_nodes[i]->visited = false;
+    }
+    sim->dff_node_count = dff_count;
+
+    struct grci_module_runtime *m = &s->module;
+    grci_ensure(grci_module_runtime_init(m, &sim->arena, input_count, output_count, part_count), GRCI_ERR_MEM, 0, "placeholder");
+    for (int i = 0; i < input_count; i++) {
+        grci_ensure(grci_read_node(r, sim, node_count, &m->inputs[i]), GRCI_ERR_IO, 0, "placeholder");
+        grci_ensure(m->inputs[i]->type == GRCI_NT_CONSTANT, GRCI_ERR_IO, 0, "module input %d is not an input node", i);
+    }
+    for (int i = 0; i < output_count; i++) {
+        grci_ensure(grci_read_node(r, sim, node_count, &m->outputs[i]), GRCI_ERR_IO, 0, "placeholder");
+    }
+
+    //the netlist has no hierarchy, so the description only keeps what is needed to look up top level parts
+    struct grci_module_desc *desc;
+    struct grci_module_desc *parts;
+    grci_ensure(grci_arena_malloc(&sim->arena, sizeof(struct grci_module_desc), (void**) &desc), GRCI_ERR_MEM, 0, "placeholder");
+    grci_ensure(grci_arena_malloc(&sim->arena, sizeof(struct grci_module_desc) * part_count, (void**) &parts), GRCI_ERR_MEM, 0, "placeholder");
+    grci_module_desc_init(desc, &sim->arena);
+    desc->name = name;
+    desc->input_count = input_count;
+    desc->output_count = output_count;
+    desc->part_count = part_count;
+    desc->node_count = node_count - 3 - input_count;
+    desc->dff_count = dff_count;
+
+    //parts are consecutive node ranges, which together can't run past the module's nodes
+    int part_nodes = 0;
+    for (int i = 0; i < part_count; i++) {
+        struct grci_module_desc *part = &parts[i];
+        grci_module_desc_init(part, &sim->arena);
+        grci_ensure(grci_read_string(r, &sim->arena, &desc->part_names[i]), GRCI_ERR_IO, 0, "placeholder");
+        grci_ensure(grci_read_string(r, &sim->arena, &part->name), GRCI_ERR_IO, 0, "placeholder");
+        grci_ensure(grci_read_int(r, desc->node_count - part_nodes + 1, &part->node_count), GRCI_ERR_IO, 0, "placeholder");
+        part_nodes += part->node_count;
+        grci_ensure(grci_read_int(r, dff_count + 1, &m->dff_off_len[i][0]), GRCI_ERR_IO, 0, "placeholder");
+        grci_ensure(grci_read_int(r, dff_count - m->dff_off_len[i][0] + 1, &m->dff_off_len[i][1]), GRCI_ERR_IO, 0, "placeholder");
+        part->is_ram64K = grci_string_matches(&part->name, "Ram64K", 6);
+        part->dff_count = m->dff_off_len[i][1];
+        grci_ensure(!part->is_ram64K || (part->dff_count == 16 && sim->dff_nodes[m->dff_off_len[i][0]]->type == GRCI_NT_RAM64KOUT),
+                    GRCI_ERR_IO, 0, "Ram64K part %d does not reference ram outputs", i);
+        desc->parts[i] = part;
+    }
+    m->desc = desc;
+
+    grci_ensure(r->off == r->count, GRCI_ERR_IO, 0, "unexpected data at end of netlist");
+
+    //a netlist isn't checked by the compiler, so one with gates on a loop is refused rather than stepped
+    grci_ensure(grci_jit_build(s, GRCI_ENGINE_LEVELIZED), GRCI_ERR_IO, 0, "placeholder");
+    grci_jit_free(sim, s->jit);
+    s->jit = NULL;
+
+    return GRCI_OK;
+}
+
+grci_status grci_export_netlist(struct grci_module *m, const char *path) {
+    struct grci_buffer b = { .data = NULL, .count = 0, .capacity = 0, .realloc = m->sim->g->client_realloc };
+    bool ok = grci_write_netlist(m->sim, &b) == GRCI_OK;
+
+    FILE *f = ok ? fopen(path, "wb") : NULL;
+    if (f) {
+        ok = fwrite(b.data, 1, b.count, f) == b.count;
+        ok = fclose(f) == 0 && ok;
+    }
+    m->sim->g->client_free(b.data);
+
+    grci_ensure(f, GRCI_ERR_IO, 0, "can't open '%s' for writing", path);
+    grci_ensure(ok, GRCI_ERR_IO, 0, "failed writing netlist '%s'", path);
+    return GRCI_OK;
+}
+
+struct grci_module *grci_import_netlist(struct grci *g, const char *path) {
+    FILE *f = fopen(path, "rb");
+    grci_ensure_retnull(f, GRCI_ERR_IO, 0, "can't open netlist '%s'", path);
+
+    fseek(f, 0L, SEEK_END);
+    long size = ftell(f);
+    rewind(f);
+    unsigned char *data = size > 0 ? g->client_malloc(size) : NULL;
+    bool ok = data && fread(data, 1, size, f) == (size_t) size;
+    fclose(f);
+    if (!ok) {
+        g->client_free(data);
+        grci_ensure_retnull(false, GRCI_ERR_IO, 0, "failed reading netlist '%s'", path);
+    }
+
+    struct grci_module *module = g->client_malloc(sizeof(struct grci_module));
+    struct grci_sim *sim = module ? g->client_malloc(sizeof(struct grci_sim)) : NULL;
+    if (!sim) {
+        g->client_free(module);
+        g->client_free(data);
+        grci_ensure_retnull(false, GRCI_ERR_MEM, 0, "malloc failed");
+    }
+    module->sim = sim;
+    memset(module->sim, 0, sizeof(struct grci_sim));
+    module->sim->g = g;
+    module->sim->step_limit = g->limits.max_cycles * 2;
+
+    struct grci_reader r = { .data = data, .count = size, .off = 0 };
+    ok = grci_read_netlist(g, module->sim, &r);
+    g->client_free(data);
+
+    ok = ok && grci_init_submodule_states(module->sim);
+    if (!ok) {
+        if (module->sim->sim.nodes) {
+            grci_simulator_cleanup(&module->sim->sim);
+        }
+        g->client_free(module->sim);
+        g->client_free(module);
+        return NULL;
+    }
+
+    module->input_count = module->sim->module.desc->input_count;
+    module->output_count = module->sim->module.desc->output_count;
+    module->inputs = g->client_malloc(sizeof(bool) * (module->input_count + 1));
+    module->outputs = g->client_malloc(sizeof(bool) * (module->output_count + 1));
+    if (!module->inputs || !module->outputs) {
+        g->client_free(module->inputs);
+        g->client_free(module->outputs);
+        grci_free_module(module);
+        grci_ensure_retnull(false, GRCI_ERR_MEM, 0, "malloc failed");
+    }
+    memset(module->inputs, 0, sizeof(bool) * module->input_count);
+    memset(module->outputs, 0, sizeof(bool) * module->output_count);
+
+    return module;
+}
+
+#undef GRCI_NETLIST_VERSION
+
 #undef GRCI_DEFAULT_CHUNK_SIZE
 #undef GRCI_RAM64K_STATE_COUNT
 
@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #if defined(_WIN32)
 #define GRCI_API __declspec(dllexport)
@@ -20,10 +21,100 @@ struct grci_module {
 
     struct grci_sim *sim;
 };
+struct grci_workers;
+struct grci_partition {
+    int input_count;
+    int output_count;
+    bool *inputs;
+    bool *outputs;
+
+    //one module per top level part, which can be set up (engines, ram contents) until the first step
+    int part_count;
+    struct grci_module **parts;
+
+    struct grci_workers *workers;
+};
 struct grci_submodule {
     int state_count;
     bool *states;
 };
+enum grci_node_order {
+    GRCI_ORDER_LEVEL,
+    GRCI_ORDER_RCM,
+    GRCI_ORDER_LANES
+};
+struct grci_activity {
+    int node_count;
+    int idle_count; //nodes that never toggled while recording
+    uint64_t toggles;
+    uint64_t steps;
+};
+enum grci_engine {
+    GRCI_ENGINE_AUTO, //from the description and a warm-up that counts gate evaluations, so the same on every run
+    GRCI_ENGINE_RECURSIVE,
+    GRCI_ENGINE_LEVELIZED,
+    GRCI_ENGINE_EVENT,
+    GRCI_ENGINE_COMPILED,
+    GRCI_ENGINE_TIMING //unit delay gates, never picked by GRCI_ENGINE_AUTO
+};
+struct grci_estimate {
+    int node_count;
+    int dff_count;
+    int ram_count;
+    size_t bytes; //peak while instantiating, with every Ram64K fully written
+};
+struct grci_limits {
+    int max_nodes; //0 for no limit
+    size_t max_bytes;
+    uint64_t max_cycles; //since the module was made or reset
+};
+struct grci_timing {
+    uint64_t settle_time; //time units from the clock edge, or from the input change on a low step, to the last transition
+    uint64_t events; //transitions in the step
+    int glitches; //nodes that changed more than once before settling
+    bool settled; //false if the step was cut off, eg by a loop that oscillates
+};
+struct grci_depth {
+    int depth; //deepest gate in the module or part, counted in nands
+    int register_depth; //longest path from a dff or ram to a dff or ram input, -1 if there is none
+    int io_depth; //longest path from a module input to a module output, -1 if there is none
+    int loop_count; //gates on combinational loops, which have no depth
+    int *histogram; //optional, histogram[d] is the number of gates at depth d, with deeper gates in the last entry
+    int histogram_size;
+    char *path; //optional, the longest path of the whole module as hierarchical part names
+    size_t path_size;
+};
+typedef uint64_t (*grci_truth_fn)(uint64_t inputs, void *user);
+struct grci_capture {
+    uint64_t *buffer;
+    size_t word_count;
+    int interval; //record every interval steps
+    const char **states; //names of submodules whose states follow the outputs in each record
+    int state_count;
+
+    //set by the library
+    int record_words;
+    size_t record_count;
+    uint64_t written; //record i is at buffer + (i % record_count) * record_words
+};
+struct grci_divergence {
+    uint64_t step;
+    int lane; //-1 if the modules never differed
+    int output; //-1 if only the compared state differed
+    int state;
+    bool *inputs; //optional, input_count bools set to the lane's inputs on the diverging step
+};
+struct grci_foreign {
+    const char *name;
+    int input_param_count;
+    const int *input_widths;
+    int output_param_count;
+    const int *output_widths;
+    size_t state_size; //zeroed for each instance and passed to the callbacks
+    void (*eval)(void *state, const bool *inputs, bool *outputs, void *user); //only called when inputs changed or after a clock
+    void (*clock)(void *state, const bool *inputs, void *user); //rising edge, optional
+    void *user;
+};
 
 GRCI_API struct grci *grci_init(void* (*malloc)(size_t), void* (*realloc)(void*, size_t), void (*free)(void*));
 GRCI_API struct grci *grci_easy_init(void);
@@ -38,5 +129,46 @@ GRCI_API void grci_set_input(struct grci_module *m, int idx, bool value);
 GRCI_API bool grci_get_output(struct grci_module *m, int idx);
 GRCI_API void grci_set_state(struct grci_submodule *m, int idx, bool value);
 GRCI_API bool grci_get_state(struct grci_submodule *m, int idx);
+GRCI_API bool grci_set_activity(struct grci_module *m, bool enabled);
+GRCI_API bool grci_activity(struct grci_module *m, const char *submodule_name, size_t len, struct grci_activity *activity);
+GRCI_API bool grci_export_netlist(struct grci_module *m, const char *path);
+GRCI_API struct grci_module *grci_import_netlist(struct grci *g, const char *path);
+GRCI_API bool grci_reorder_nodes(struct grci_module *m, enum grci_node_order order);
+GRCI_API bool grci_ram_load(struct grci_module *m, const char *submodule_name, size_t len, size_t offset, const void *data, size_t size);
+GRCI_API bool grci_ram_dump(struct grci_module *m, const char *submodule_name, size_t len, size_t offset, void *data, size_t size);
+GRCI_API bool grci_ram_load_file(struct grci_module *m, const char *submodule_name, size_t len, size_t offset, const char *path);
+GRCI_API bool grci_ram_dump_file(struct grci_module *m, const char *submodule_name, size_t len, size_t offset, size_t size, const char *path);
+GRCI_API bool grci_ram_share(struct grci_module *dst, const char *dst_name, size_t dst_len, struct grci_module *src, const char *src_name, size_t src_len);
+GRCI_API bool grci_set_checkpoints(struct grci_module *m, int interval, size_t budget);
+GRCI_API bool grci_seek_module(struct grci_module *m, uint64_t step);
+GRCI_API uint64_t grci_step_count(struct grci_module *m);
+GRCI_API bool grci_set_journal(struct grci_module *m, size_t max_bytes);
+GRCI_API bool grci_step_back(struct grci_module *m);
+GRCI_API bool grci_set_jit(struct grci_module *m, bool enabled);
+GRCI_API bool grci_fuse_gates(struct grci_module *m);
+GRCI_API bool grci_truth_table(struct grci_module *m, uint64_t *table, size_t word_count);
+GRCI_API bool grci_check_truth_table(struct grci_module *m, grci_truth_fn reference, void *user);
+GRCI_API bool grci_check_equivalent(struct grci *g, const char *name_a, size_t len_a, const char *name_b, size_t len_b, uint64_t cycles,
+                                    uint64_t seed, const char *state_name, size_t state_len, struct grci_divergence *divergence);
+GRCI_API bool grci_set_capture(struct grci_module *m, struct grci_capture *capture);
+GRCI_API bool grci_run_module(struct grci_module *m, uint64_t count);
+GRCI_API bool grci_step_edge(struct grci_module *m, bool rising);
+GRCI_API bool grci_step_cycle(struct grci_module *m);
+GRCI_API bool grci_save_power_on(struct grci_module *m);
+GRCI_API bool grci_reset_module(struct grci_module *m);
+GRCI_API void grci_set_pool(struct grci *g, int limit);
+GRCI_API bool grci_link(struct grci_module *dst, int dst_input, struct grci_module *src, int src_output, int width);
+GRCI_API bool grci_step_linked(struct grci_module *m);
+GRCI_API bool grci_register_foreign(struct grci *g, const struct grci_foreign *foreign);
+GRCI_API bool grci_set_engine(struct grci_module *m, enum grci_engine engine);
+GRCI_API enum grci_engine grci_get_engine(struct grci_module *m, const char **reason);
+GRCI_API bool grci_estimate_module(struct grci *g, const char *module_name, size_t len, struct grci_estimate *estimate);
+GRCI_API void grci_set_limits(struct grci *g, const struct grci_limits *limits);
+GRCI_API bool grci_set_delay(struct grci_module *m, const char *submodule_name, size_t len, int delay);
+GRCI_API bool grci_get_timing(struct grci_module *m, struct grci_timing *timing);
+GRCI_API bool grci_depth(struct grci_module *m, const char *submodule_name, size_t len, struct grci_depth *depth);
+GRCI_API struct grci_partition *grci_partition_module(struct grci *g, const char *module_name, size_t len, int worker_count);
+GRCI_API bool grci_step_partition(struct grci_partition *p);
+GRCI_API void grci_destroy_partition(struct grci_partition *p);
 
 #endif
@@ -20,6 +20,15 @@ def init():
                     ("inputs", POINTER(c_bool)),
                     ("outputs", POINTER(c_bool))]
 
+    class GRCIPartition(Structure):
+        _fields_ = [("input_count", c_int),
+                    ("output_count", c_int),
+                    ("inputs", POINTER(c_bool)),
+                    ("outputs", POINTER(c_bool)),
+                    ("part_count", c_int),
+                    ("parts", POINTER(c_void_p)),
+                    ("workers", c_void_p)]
+
     class GRCISubmodule(Structure):
         _fields_ = [("state_count", c_int),
                     ("states", POINTER(c_bool))]
@@ -46,11 +55,208 @@ def init():
     lib.grci_cleanup.argtypes = [c_void_p]
     lib.grci_cleanup.restype = None
 
+    lib.grci_export_netlist.argtypes = [c_void_p, c_char_p]
+    lib.grci_export_netlist.restype = c_bool
+
+    lib.grci_import_netlist.argtypes = [c_void_p, c_char_p]
+    lib.grci_import_netlist.restype = POINTER(GRCIModule)
+
+    lib.grci_set_activity.argtypes = [c_void_p, c_bool]
+    lib.grci_set_activity.restype = c_bool
+
+    lib.grci_activity.argtypes = [c_void_p, c_char_p, c_size_t, POINTER(Activity)]
+    lib.grci_activity.restype = c_bool
+
+    lib.grci_reorder_nodes.argtypes = [c_void_p, c_int]
+    lib.grci_reorder_nodes.restype = c_bool
+
+    lib.grci_ram_load.argtypes = [c_void_p, c_char_p, c_size_t, c_size_t, c_char_p, c_size_t]
+    lib.grci_ram_load.restype = c_bool
+
+    lib.grci_ram_dump.argtypes = [c_void_p, c_char_p, c_size_t, c_size_t, c_char_p, c_size_t]
+    lib.grci_ram_dump.restype = c_bool
+
+    lib.grci_ram_load_file.argtypes = [c_void_p, c_char_p, c_size_t, c_size_t, c_char_p]
+    lib.grci_ram_load_file.restype = c_bool
+
+    lib.grci_ram_dump_file.argtypes = [c_void_p, c_char_p, c_size_t, c_size_t, c_size_t, c_char_p]
+    lib.grci_ram_dump_file.restype = c_bool
+
+    lib.grci_ram_share.argtypes = [c_void_p, c_char_p, c_size_t, c_void_p, c_char_p, c_size_t]
+    lib.grci_ram_share.restype = c_bool
+
+    lib.grci_set_checkpoints.argtypes = [c_void_p, c_int, c_size_t]
+    lib.grci_set_checkpoints.restype = c_bool
+
+    lib.grci_seek_module.argtypes = [c_void_p, c_uint64]
+    lib.grci_seek_module.restype = c_bool
+
+    lib.grci_step_count.argtypes = [c_void_p]
+    lib.grci_step_count.restype = c_uint64
+
+    lib.grci_set_journal.argtypes = [c_void_p, c_size_t]
+    lib.grci_set_journal.restype = c_bool
+
+    lib.grci_step_back.argtypes = [c_void_p]
+    lib.grci_step_back.restype = c_bool
+
+    lib.grci_set_jit.argtypes = [c_void_p, c_bool]
+    lib.grci_set_jit.restype = c_bool
+
+    lib.grci_set_engine.argtypes = [c_void_p, c_int]
+    lib.grci_set_engine.restype = c_bool
+
+    lib.grci_get_engine.argtypes = [c_void_p, POINTER(c_char_p)]
+    lib.grci_get_engine.restype = c_int
+
+    lib.grci_fuse_gates.argtypes = [c_void_p]
+    lib.grci_fuse_gates.restype = c_bool
+
+    lib.grci_truth_table.argtypes = [c_void_p, POINTER(c_uint64), c_size_t]
+    lib.grci_truth_table.restype = c_bool
+
+    lib.grci_run_module.argtypes = [c_void_p, c_uint64]
+    lib.grci_run_module.restype = c_bool
+
+    lib.grci_step_cycle.argtypes = [c_void_p]
+    lib.grci_step_cycle.restype = c_bool
+
+    lib.grci_save_power_on.argtypes = [c_void_p]
+    lib.grci_save_power_on.restype = c_bool
+
+    lib.grci_reset_module.argtypes = [c_void_p]
+    lib.grci_reset_module.restype = c_bool
+
+    lib.grci_set_pool.argtypes = [c_void_p, c_int]
+
+    lib.grci_link.argtypes = [c_void_p, c_int, c_void_p, c_int, c_int]
+    lib.grci_link.restype = c_bool
+
+    lib.grci_step_linked.argtypes = [c_void_p]
+    lib.grci_step_linked.restype = c_bool
+
+    lib.grci_set_capture.argtypes = [c_void_p, c_void_p]
+    lib.grci_set_capture.restype = c_bool
+
+    lib.grci_check_equivalent.argtypes = [c_void_p, c_char_p, c_size_t, c_char_p, c_size_t, c_uint64, c_uint64, c_char_p, c_size_t, c_void_p]
+    lib.grci_check_equivalent.restype = c_bool
+
+    lib.grci_estimate_module.argtypes = [c_void_p, c_char_p, c_size_t, POINTER(Estimate)]
+    lib.grci_estimate_module.restype = c_bool
+
+    lib.grci_set_limits.argtypes = [c_void_p, POINTER(Limits)]
+    lib.grci_set_limits.restype = None
+
+    lib.grci_register_foreign.argtypes = [c_void_p, POINTER(Foreign)]
+    lib.grci_register_foreign.restype = c_bool
+
+    lib.grci_set_delay.argtypes = [c_void_p, c_char_p, c_size_t, c_int]
+    lib.grci_set_delay.restype = c_bool
+
+    lib.grci_get_timing.argtypes = [c_void_p, POINTER(Timing)]
+    lib.grci_get_timing.restype = c_bool
+
+    lib.grci_depth.argtypes = [c_void_p, c_char_p, c_size_t, POINTER(Depth)]
+    lib.grci_depth.restype = c_bool
+
+    lib.grci_partition_module.argtypes = [c_void_p, c_char_p, c_size_t, c_int]
+    lib.grci_partition_module.restype = POINTER(GRCIPartition)
+
+    lib.grci_step_partition.argtypes = [POINTER(GRCIPartition)]
+    lib.grci_step_partition.restype = c_bool
+
+    lib.grci_destroy_partition.argtypes = [POINTER(GRCIPartition)]
+    lib.grci_destroy_partition.restype = None
+
 
     global g
     g = lib.grci_easy_init()
 
 
+#steps modules[0] and everything linked to it.  Inputs driven by links are overwritten from the source outputs
+def step_linked(modules):
+    for m in modules:
+        for idx, value in enumerate(m.inp):
+            m.module.contents.inputs[idx] = value
+    clock = lib.grci_step_linked(modules[0].module)
+    for m in modules:
+        for idx in range(m.output_count):
+            m.out[idx] = m.module.contents.outputs[idx]
+    return clock
+
+
+#destroyed modules are kept for reuse, up to limit per module type
+def set_pool(limit):
+    lib.grci_set_pool(g, limit)
+
+
+#this must match the order of fields in struct grci_activity
+class Activity(Structure):
+    _fields_ = [("node_count", c_int),
+                ("idle_count", c_int),
+                ("toggles", c_uint64),
+                ("steps", c_uint64)]
+
+#these must match the order of fields in struct grci_estimate and struct grci_limits
+class Estimate(Structure):
+    _fields_ = [("node_count", c_int),
+                ("dff_count", c_int),
+                ("ram_count", c_int),
+                ("bytes", c_size_t)]
+
+class Limits(Structure):
+    _fields_ = [("max_nodes", c_int),
+                ("max_bytes", c_size_t),
+                ("max_cycles", c_uint64)]
+
+#what instantiating the module would take, or None if it doesn't exist
+def estimate(name):
+    c_name = name.encode('utf-8')
+    e = Estimate()
+    return e if lib.grci_estimate_module(g, c_name, c_size_t(len(c_name)), byref(e)) else None
+
+#0 leaves a cap off.  Modules over a cap can't be made, and steps past max_cycles are ignored
+def set_limits(max_nodes=0, max_bytes=0, max_cycles=0):
+    lib.grci_set_limits(g, byref(Limits(max_nodes, max_bytes, max_cycles)))
+
+
+EvalFn = CFUNCTYPE(None, c_void_p, POINTER(c_bool), POINTER(c_bool), c_void_p)
+ClockFn = CFUNCTYPE(None, c_void_p, POINTER(c_bool), c_void_p)
+
+#this must match order of fields in struct grci_foreign
+class Foreign(Structure):
+    _fields_ = [("name", c_char_p),
+                ("input_param_count", c_int),
+                ("input_widths", POINTER(c_int)),
+                ("output_param_count", c_int),
+                ("output_widths", POINTER(c_int)),
+                ("state_size", c_size_t),
+                ("eval", EvalFn),
+                ("clock", ClockFn),
+                ("user", c_void_p)]
+
+foreign_refs = []
+
+#eval(state, inputs, outputs) and clock(state, inputs) get a ctypes pointer to state_size bytes and bool arrays
+def register_foreign(name, input_widths, output_widths, state_size, eval, clock=None):
+    ins = (c_int * len(input_widths))(*input_widths)
+    outs = (c_int * len(output_widths))(*output_widths)
+    eval_fn = EvalFn(lambda state, i, o, user: eval(cast(state, POINTER(c_uint8)), i, o))
+    clock_fn = ClockFn(lambda state, i, user: clock(cast(state, POINTER(c_uint8)), i)) if clock else ClockFn()
+    #the library keeps the callbacks, so they have to outlive this call
+    foreign_refs.extend([eval_fn, clock_fn])
+    f = Foreign(name.encode('utf-8'), len(input_widths), ins, len(output_widths), outs, state_size, eval_fn, clock_fn, None)
+    return lib.grci_register_foreign(g, byref(f))
+
+
+def check_equivalent(name_a, name_b, cycles, seed, state=None):
+    a = name_a.encode('utf-8')
+    b = name_b.encode('utf-8')
+    s = state.encode('utf-8') if state else None
+    return lib.grci_check_equivalent(g, a, c_size_t(len(a)), b, c_size_t(len(b)), c_uint64(cycles), c_uint64(seed),
+                                     s, c_size_t(len(s) if s else 0), None)
+
+
 def compile_src(src):
     size = len(src)
     c_string = src.encode('utf-8')
@@ -70,10 +276,89 @@ class Submodule:
         for idx in range(self.submodule.contents.state_count):
             self.states[idx] = self.submodule.contents.states[idx]
 
+class Capture(Structure):
+    _fields_ = [("buffer", POINTER(c_uint64)),
+                ("word_count", c_size_t),
+                ("interval", c_int),
+                ("states", POINTER(c_char_p)),
+                ("state_count", c_int),
+                ("record_words", c_int),
+                ("record_count", c_size_t),
+                ("written", c_uint64)]
+
+ORDER_LEVEL = 0
+ORDER_RCM = 1
+ORDER_LANES = 2
+
+ENGINE_AUTO = 0
+ENGINE_RECURSIVE = 1
+ENGINE_LEVELIZED = 2
+ENGINE_EVENT = 3
+ENGINE_COMPILED = 4
+ENGINE_TIMING = 5
+
+#this must match the order of fields in struct grci_timing
+class Timing(Structure):
+    _fields_ = [("settle_time", c_uint64),
+                ("events", c_uint64),
+                ("glitches", c_int),
+                ("settled", c_bool)]
+
+#A module split into one module per top level part, stepped by worker_count processes, or in this
+#process if it's 0.  Values crossing between parts arrive a step later
+class Partition:
+    def __init__(self, name, worker_count=0):
+        c_name = name.encode('utf-8')
+        self.partition = lib.grci_partition_module(g, c_name, c_size_t(len(c_name)), worker_count)
+        if not self.partition:
+            return
+        self.input_count = self.partition.contents.input_count
+        self.output_count = self.partition.contents.output_count
+        self.inp = [False] * self.input_count
+        self.out = [False] * self.output_count
+
+    def step(self):
+        for idx, value in enumerate(self.inp):
+            self.partition.contents.inputs[idx] = value
+        ok = lib.grci_step_partition(self.partition)
+        for idx in range(self.output_count):
+            self.out[idx] = self.partition.contents.outputs[idx]
+        return ok
+
+    def destroy(self):
+        lib.grci_destroy_partition(self.partition)
+
+
+#this must match the order of fields in struct grci_depth
+class Depth(Structure):
+    _fields_ = [("depth", c_int),
+                ("register_depth", c_int),
+                ("io_depth", c_int),
+                ("loop_count", c_int),
+                ("histogram", POINTER(c_int)),
+                ("histogram_size", c_int),
+                ("path", c_char_p),
+                ("path_size", c_size_t)]
+
 class Module:
-    def __init__(self, name):
+    #if order is given, nodes are reordered before anything else
+    #if netlist_path is given, the module is exported to a netlist and re-imported from that file
+    #if fuse is set, nand patterns are replaced with fused gates
+    #if engine is given, the module is stepped with that ENGINE_* instead of the recursive interpreter
+    def __init__(self, name, netlist_path=None, order=None, engine=None, fuse=False):
         c_name = name.encode('utf-8')
         self.module = lib.grci_init_module(g, c_name, c_size_t(len(name)))
+        if order != None:
+            lib.grci_reorder_nodes(self.module, order)
+        if netlist_path != None:
+            c_path = netlist_path.encode('utf-8')
+            if lib.grci_export_netlist(self.module, c_path):
+                lib.grci_destroy_module(self.module)
+                self.module = lib.grci_import_netlist(g, c_path)
+        if fuse:
+            lib.grci_fuse_gates(self.module)
+        if engine != None:
+            lib.grci_set_engine(self.module, engine)
         self.input_count = self.module.contents.input_count
         self.output_count = self.module.contents.output_count
         self.inp = [False] * self.input_count
@@ -97,6 +382,156 @@ class Module:
 
         return clock
 
+    #a low step then a high one, with outputs only evaluated after the high step
+    def step_cycle(self):
+        for idx, value in enumerate(self.inp):
+            self.module.contents.inputs[idx] = value
+        clock = lib.grci_step_cycle(self.module)
+        for idx in range(self.module.contents.output_count):
+            self.out[idx] = self.module.contents.outputs[idx]
+        return clock
+
+    #drives width of this module's inputs, starting at idx, from src's outputs starting at src_idx
+    def link(self, idx, src, src_idx, width):
+        return lib.grci_link(self.module, idx, src.module, src_idx, width)
+
+    def set_activity(self, enabled):
+        return lib.grci_set_activity(self.module, enabled)
+
+    #toggle counts since activity recording was enabled, for the part name or the whole module if it's None
+    def activity(self, name=None):
+        a = Activity()
+        c_name = name.encode('utf-8') if name != None else None
+        ok = lib.grci_activity(self.module, c_name, c_size_t(len(c_name) if c_name else 0), byref(a))
+        return a if ok else None
+
+    #returns the ENGINE_* stepping the module and why it was picked
+    def engine(self):
+        reason = c_char_p()
+        engine = lib.grci_get_engine(self.module, byref(reason))
+        return engine, reason.value.decode('utf-8')
+
+    #gate delays for ENGINE_TIMING, in a top level part or everywhere if name is None
+    def set_delay(self, name, delay):
+        c_name = name.encode('utf-8') if name != None else None
+        return lib.grci_set_delay(self.module, c_name, c_size_t(len(c_name) if c_name else 0), delay)
+
+    #what ENGINE_TIMING saw on the last step, or None with another engine
+    def timing(self):
+        t = Timing()
+        return t if lib.grci_get_timing(self.module, byref(t)) else None
+
+    #longest nand paths, with the histogram for the part name or the whole module if it's None.
+    #Returns the Depth, the histogram as a list and the critical path as a list of part names
+    def depth(self, name=None, histogram_size=64, path_size=4096):
+        hist = (c_int * histogram_size)()
+        path = create_string_buffer(path_size)
+        d = Depth(0, 0, 0, 0, hist, histogram_size, cast(path, c_char_p), path_size)
+        c_name = name.encode('utf-8') if name != None else None
+        if not lib.grci_depth(self.module, c_name, c_size_t(len(c_name) if c_name else 0), byref(d)):
+            return None
+        return d, list(hist), path.value.decode('utf-8').split(" > ")
+
+    #writes the bytes into the Ram64K part name, starting at byte offset
+    def ram_load(self, name, offset, data):
+        c_name = name.encode('utf-8')
+        return lib.grci_ram_load(self.module, c_name, c_size_t(len(c_name)), c_size_t(offset), data, c_size_t(len(data)))
+
+    #returns size bytes of the Ram64K part name from byte offset, or None if they don't fit
+    def ram_dump(self, name, offset, size):
+        c_name = name.encode('utf-8')
+        data = create_string_buffer(max(size, 1))
+        if not lib.grci_ram_dump(self.module, c_name, c_size_t(len(c_name)), c_size_t(offset), data, c_size_t(size)):
+            return None
+        return data.raw[:size]
+
+    def ram_load_file(self, name, offset, path):
+        c_name = name.encode('utf-8')
+        return lib.grci_ram_load_file(self.module, c_name, c_size_t(len(c_name)), c_size_t(offset), path.encode('utf-8'))
+
+    def ram_dump_file(self, name, offset, size, path):
+        c_name = name.encode('utf-8')
+        return lib.grci_ram_dump_file(self.module, c_name, c_size_t(len(c_name)), c_size_t(offset), c_size_t(size), path.encode('utf-8'))
+
+    #the Ram64K part name reads src's part src_name, until either one writes to a page
+    def ram_share(self, name, src, src_name):
+        c_name = name.encode('utf-8')
+        c_src = src_name.encode('utf-8')
+        return lib.grci_ram_share(self.module, c_name, c_size_t(len(c_name)), src.module, c_src, c_size_t(len(c_src)))
+
+    #checkpoints every interval steps, with budget bytes for them and the input history
+    def set_checkpoints(self, interval, budget):
+        return lib.grci_set_checkpoints(self.module, interval, c_size_t(budget))
+
+    #goes back to a recorded step by restoring a checkpoint and replaying the inputs from it
+    def seek(self, step):
+        ok = lib.grci_seek_module(self.module, c_uint64(step))
+        for idx in range(self.output_count):
+            self.out[idx] = self.module.contents.outputs[idx]
+        return ok
+
+    def step_count(self):
+        return lib.grci_step_count(self.module)
+
+    #journals up to max_bytes of changes, so steps can be undone with step_back
+    def set_journal(self, max_bytes):
+        return lib.grci_set_journal(self.module, c_size_t(max_bytes))
+
+    def step_back(self):
+        ok = lib.grci_step_back(self.module)
+        for idx in range(self.output_count):
+            self.out[idx] = self.module.contents.outputs[idx]
+        return ok
+
+    #the current state becomes what reset restores
+    def save_power_on(self):
+        return lib.grci_save_power_on(self.module)
+
+    def reset(self):
+        ok = lib.grci_reset_module(self.module)
+        self.inp = [False] * self.input_count
+        for idx in range(self.output_count):
+            self.out[idx] = self.module.contents.outputs[idx]
+        for key in self.submodules:
+            self.submodules[key].read_states()
+        return ok
+
+    #steps count times with the current inputs, without copying anything in or out in between
+    def run(self, count):
+        for idx, value in enumerate(self.inp):
+            self.module.contents.inputs[idx] = value
+        clock = lib.grci_run_module(self.module, c_uint64(count))
+        for idx in range(self.module.contents.output_count):
+            self.out[idx] = self.module.contents.outputs[idx]
+        return clock
+
+    #records outputs, followed by the states of the named submodules, every interval steps into a ring of words
+    def capture(self, words, interval=1, states=[]):
+        names = [n.encode('utf-8') for n in states]
+        self.capture_names = (c_char_p * (len(names) + 1))(*names)
+        self.capture_buffer = (c_uint64 * words)()
+        self.capture_data = Capture(self.capture_buffer, words, interval, self.capture_names, len(names), 0, 0, 0)
+        return lib.grci_set_capture(self.module, byref(self.capture_data))
+
+    #captured records as integers, oldest first
+    def history(self):
+        c = self.capture_data
+        first = max(0, c.written - c.record_count)
+        records = []
+        for i in range(first, c.written):
+            off = (i % c.record_count) * c.record_words
+            records.append(sum(self.capture_buffer[off + w] << (64 * w) for w in range(c.record_words)))
+        return records
+
+    #returns one integer per output where bit p is the output for input pattern p (input i is bit i of p),
+    #or None if the module isn't combinational
+    def truth_table(self):
+        words = (2 ** self.input_count + 63) // 64
+        table = (c_uint64 * (words * self.output_count))()
+        if not lib.grci_truth_table(self.module, table, c_size_t(len(table))):
+            return None
+        return [sum(table[k * words + w] << (64 * w) for w in range(words)) for k in range(self.output_count)]
+
     #returns a reference to the list of module states
     def submodule(self, name):
         if name in self.submodules:
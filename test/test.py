@@ -1,3 +1,4 @@
+import platform
 import grci
 import builtin_modules
 import basic
@@ -6,10 +7,14 @@ total = 0
 passed = 0
 failed = 0
 
-def test_module(name, cases):
+#modules known to fail, run only by the first file that lists them so new failures stay visible
+known_failures = ["CycleBug"]
+known_seen = []
+
+def test_module(name, cases, netlist_path, order, engine, fuse):
     global total, failed, passed
 
-    module = grci.Module(name)
+    module = grci.Module(name, netlist_path, order, engine, fuse)
     ok = True
     for c in cases:
         c = c.replace(" ", "")
@@ -40,7 +45,16 @@ def test_module(name, cases):
         failed += 1
     total += 1
 
-def test_file(tests, hdl_path):
+#counts a test that isn't a module's cases, and names it when it fails
+def report(name, ok):
+    global total, failed, passed
+    total += 1
+    passed += 1 if ok else 0
+    failed += 0 if ok else 1
+    if not ok:
+        print(name + " failed")
+
+def test_file(tests, hdl_path, netlist_path=None, order=None, engine=None, fuse=False):
     grci.init()
 
     if not hdl_path == None:
@@ -49,14 +63,579 @@ def test_file(tests, hdl_path):
             grci.compile_src(src)
 
     for t in tests:
-        test_module(t[0], t[1])
+        if t[0] in known_failures:
+            if t[0] in known_seen:
+                continue
+            known_seen.append(t[0])
+        test_module(t[0], t[1], netlist_path, order, engine, fuse)
+
+    grci.quit()
+
+#checks the test cases of combinational modules against their truth table instead of stepping
+def test_truth_tables(tests, hdl_path):
+    grci.init()
+    with open(hdl_path, "r") as f:
+        grci.compile_src(f.read())
+
+    for name, cases in tests:
+        if name in known_failures:
+            continue
+        module = grci.Module(name)
+        if module.input_count > 16:
+            continue
+        table = module.truth_table()
+        if table == None:
+            continue
+        ok = True
+        for c in cases:
+            c = c.replace(" ", "")
+            pattern = sum(1 << i for i, v in enumerate(c[:module.input_count]) if v == "1")
+            for k, v in enumerate(c[module.input_count:]):
+                ok = ok and ((table[k] >> pattern) & 1) == (v == "1")
+        report(name + " truth table", ok)
+
+    grci.quit()
+
+
+def test_equivalence(hdl_path):
+    grci.init()
+    with open(hdl_path, "r") as f:
+        grci.compile_src(f.read())
+
+    pairs = [("Nand2", "Nand2Infer", None, True),
+             ("Test1", "Test2", None, False),
+             ("Bit", "BitAlt", None, True),
+             ("NamedBit", "NamedBitAlt", "bit", True),
+             ("Bit", "Not", None, False)]
+    for a, b, state, expected in pairs:
+        ok = grci.check_equivalent(a, b, 200, 1, state) == expected
+        report(a + " and " + b + " equivalence check", ok)
+
+    grci.quit()
+
+
+def test_capture(hdl_path):
+    grci.init()
+    with open(hdl_path, "r") as f:
+        grci.compile_src(f.read())
+
+    #records are out, then the bit's dff.  The dff loads on the second (high) step
+    module = grci.Module("NamedBit")
+    module.capture(2, 1, ["bit"])
+    module.inp = [True, True]
+    module.run(1)
+    ok = module.history() == [0]
+    module.run(3)
+    ok = ok and module.history() == [3, 3] and module.capture_data.written == 4
+    report("capture", ok)
+
+    grci.quit()
+
+
+def test_cycles(hdl_path):
+    grci.init()
+    with open(hdl_path, "r") as f:
+        grci.compile_src(f.read())
+
+    #full cycles must end up where pairs of half steps do
+    for engine in [None, grci.ENGINE_COMPILED]:
+        halves = grci.Module("Shift4", None, None, engine)
+        cycles = grci.Module("Shift4", None, None, engine)
+        ok = True
+        for i in range(40):
+            inp = [i % 3 == 0, i % 5 != 2]
+            halves.inp = inp
+            cycles.inp = inp
+            halves.step()
+            halves.step()
+            ok = ok and cycles.step_cycle() and halves.out == cycles.out
+        report("full cycle stepping", ok)
+
+    grci.quit()
+
+
+def test_reset(hdl_path):
+    grci.init()
+    with open(hdl_path, "r") as f:
+        grci.compile_src(f.read())
+
+    module = grci.Module("Shift4")
+    runs = []
+    for r in range(2):
+        trace = []
+        for i in range(20):
+            module.inp = [i % 3 == 0, i % 5 != 2]
+            module.step()
+            trace.append(list(module.out))
+        runs.append(trace)
+        module.reset()
+    ok = runs[0] == runs[1]
+
+    #a saved power-on state comes back instead of zeros
+    module = grci.Module("NamedBit")
+    bit = module.submodule("bit")
+    module.inp = [True, True]
+    module.step_cycle()
+    module.save_power_on()
+    module.inp = [False, True]
+    module.step_cycle()
+    ok = ok and module.out == [False] and module.reset() and module.out == [True] and bit.states[0]
+    report("reset", ok)
+
+    grci.quit()
+
+
+def test_pool(hdl_path):
+    grci.init()
+    with open(hdl_path, "r") as f:
+        grci.compile_src(f.read())
+
+    #a pooled instance comes back reset, so it must step exactly like the first one did
+    grci.set_pool(2)
+    traces = []
+    addresses = []
+    for r in range(3):
+        module = grci.Module("Shift4")
+        addresses.append(grci.addressof(module.module.contents))
+        trace = []
+        for i in range(20):
+            module.inp = [i % 3 == 0, i % 5 != 2]
+            module.step()
+            trace.append(list(module.out))
+        traces.append(trace)
+        del module
+    ok = traces[0] == traces[1] == traces[2] and addresses[0] == addresses[1] == addresses[2]
+    report("instance pool", ok)
+
+    grci.quit()
+
+
+def test_links(hdl_path):
+    grci.init()
+    with open(hdl_path, "r") as f:
+        grci.compile_src(f.read())
+
+    #b's shift input is linked to a's last stage, and linking is declared sink first to check the ordering
+    a = grci.Module("Shift4")
+    b = grci.Module("Shift4")
+    ok = b.link(0, a, 0, 1)
+    host_a = grci.Module("Shift4")
+    host_b = grci.Module("Shift4")
+    for i in range(30):
+        a.inp = [i % 3 == 0, True]
+        b.inp = [False, i % 4 != 1]
+        grci.step_linked([b, a])
+        host_a.inp = list(a.inp)
+        host_a.step()
+        host_b.inp = [host_a.out[0], b.inp[1]]
+        host_b.step()
+        ok = ok and a.out == host_a.out and b.out == host_b.out
+    report("module links", ok)
+
+    grci.quit()
+
+
+def test_activity():
+    grci.init()
+    grci.compile_src("module Not(in) -> out { Nand(in, in) -> out }\n"
+                     "module Blink(en) -> out, x, y { n: Not(q) -> nq  d: Dff(nq) -> q  a: Nand(en, q) -> out  nq -> x  q -> y }")
+
+    #d flips on the 5 rising edges, n follows it after first settling to 1, and a follows q until en drops
+    ok = True
+    for order, fuse in [(None, False), (grci.ORDER_RCM, False), (None, True)]:
+        m = grci.Module("Blink", None, order, None, fuse)
+        ok = ok and m.set_activity(True)
+        for i in range(10):
+            m.inp = [i < 6]
+            m.step()
+        counts = [m.activity(name).toggles for name in ["n", "d", "a"]]
+        whole = m.activity()
+        ok = ok and counts == [6, 5, 5] and whole.steps == 10 and whole.idle_count == 0 and whole.toggles >= sum(counts) + 2
+        ok = ok and m.set_activity(False) and m.activity() == None
+    report("activity", ok)
+
+    grci.quit()
+
+
+def test_foreign():
+    grci.init()
+    calls = [0]
+    def toggle_eval(state, inputs, outputs):
+        calls[0] += 1
+        outputs[0] = state[0] == 1
+    def toggle_clock(state, inputs):
+        if inputs[0]:
+            state[0] ^= 1
+    ok = grci.register_foreign("Toggle", [1], [1], 1, toggle_eval, toggle_clock)
+    grci.compile_src("module Not(in) -> out { Nand(in, in) -> out }\n"
+                     "module Blinker(en) -> q, nq { Toggle(en) -> t  t -> q  Not(t) -> nq }")
+
+    m = grci.Module("Blinker")
+    expected = False
+    for i in range(20):
+        m.inp = [i % 5 != 0]
+        m.step_cycle()
+        expected = expected != m.inp[0]
+        ok = ok and m.out == [expected, not expected]
+    #once after each rising edge, and nothing on the low steps where en didn't change
+    ok = ok and calls[0] <= 2 * 20 + 1
+    ok = ok and not grci.register_foreign("Toggle", [1], [1], 1, toggle_eval, toggle_clock)
+
+    #host state in a foreign part isn't saved, so anything that would restore it is refused and reset zeroes it
+    ok = ok and not m.set_checkpoints(4, 1 << 16) and not m.set_journal(1024) and not m.save_power_on()
+    m.inp = [True]
+    m.step_cycle()
+    ok = ok and m.out == [True, False] and m.reset()
+    expected = False
+    for i in range(5):
+        m.inp = [i % 5 != 0]
+        m.step_cycle()
+        expected = expected != m.inp[0]
+        ok = ok and m.out == [expected, not expected]
+    report("foreign modules", ok)
+
+    grci.quit()
+
+
+#auto picks an engine that gives the same results as the interpreter, and says why
+def test_engines(hdl_path):
+    grci.init()
+    with open(hdl_path, "r") as f:
+        grci.compile_src(f.read())
+
+    ok = True
+    for name in ["Shift4", "Mux4Way16"]:
+        auto = grci.Module(name, None, None, grci.ENGINE_AUTO)
+        ref = grci.Module(name)
+        engine, reason = auto.engine()
+        ok = ok and engine != grci.ENGINE_AUTO and len(reason) > 0 and ref.engine()[0] == grci.ENGINE_RECURSIVE
+        for i in range(40):
+            auto.inp = [(i * 7 + k) % 5 == 0 for k in range(auto.input_count)]
+            ref.inp = list(auto.inp)
+            auto.step()
+            ref.step()
+            ok = ok and auto.out == ref.out
+
+    #the warm-up counts gates evaluated rather than timing them, so the choice is the same on every run.
+    #A 4 way mux whose inputs rarely change goes to the event driven engine
+    expected = [("Shift4", grci.ENGINE_RECURSIVE, "49 nodes are too few to be worth scheduling"),
+                ("Mux4Way16", grci.ENGINE_EVENT, "549 nodes, 0 dffs, 2% of gates evaluated per step in warm-up")]
+    for name, engine, reason in expected:
+        for run in range(2):
+            ok = ok and grci.Module(name, None, None, grci.ENGINE_AUTO).engine() == (engine, reason)
+    grci.quit()
+
+    #every dff of Churn flips on every cycle, so half the gates change on each step
+    grci.init()
+    grci.compile_src("module Not(in) -> out { Nand(in, in) -> out }\n"
+                     "module Flip(x) -> q { Not(x) -> n  Dff(n) -> d  d -> q }\n"
+                     "module Flip8(x[8]) -> q[8] { Flip(x[0]) -> q[0]  Flip(x[1]) -> q[1]  Flip(x[2]) -> q[2]  Flip(x[3]) -> q[3]  "
+                     "Flip(x[4]) -> q[4]  Flip(x[5]) -> q[5]  Flip(x[6]) -> q[6]  Flip(x[7]) -> q[7] }\n"
+                     "module Churn() -> w[8], x[8], y[8], z[8] { Flip8(a) -> a  Flip8(b) -> b  Flip8(c) -> c  Flip8(d) -> d  "
+                     "a -> w  b -> x  c -> y  d -> z }")
+    levelized = grci.ENGINE_COMPILED if platform.machine() == "x86_64" else grci.ENGINE_LEVELIZED
+    for run in range(2):
+        ok = ok and grci.Module("Churn", None, None, grci.ENGINE_AUTO).engine() == (levelized, "67 nodes, 32 dffs, 50% of gates evaluated per step in warm-up")
+    report("engine selection", ok)
+
+    grci.quit()
+
+
+def test_timing(hdl_path):
+    grci.init()
+    with open(hdl_path, "r") as f:
+        grci.compile_src(f.read())
+
+    #a combinational change settles in a time that scales with the gate delay
+    settle = []
+    for delay in [1, 2]:
+        m = grci.Module("Mux4Way16", None, None, grci.ENGINE_TIMING)
+        ok = m.set_delay(None, delay)
+        m.inp = [False] * m.input_count
+        m.step()
+        m.step()
+        m.inp = [True] * 16 + [False] * (m.input_count - 16)
+        m.step()
+        t = m.timing()
+        ok = ok and t != None and t.settled and t.events > 0 and m.out == [True] * 16
+        settle.append(t.settle_time)
+    ok = ok and settle[0] > 0 and settle[1] == 2 * settle[0]
+    ok = ok and not m.set_delay(None, 0) and grci.Module("Mux4Way16").timing() == None
+    report("timing", ok)
+
+    grci.quit()
+
+
+def test_depth(hdl_path):
+    grci.init()
+    with open(hdl_path, "r") as f:
+        grci.compile_src(f.read())
+
+    #a mux is a not, an and and an or, 7 nands deep, and a 4 way mux of 16 bits is three of them in a row
+    mux, hist, path = grci.Module("Mux4Way16").depth()
+    ok = mux.depth == 13 and mux.io_depth == 13 and mux.register_depth == -1 and mux.loop_count == 0
+    ok = ok and len(path) == 15 and path[0].startswith("input") and path[-1].startswith("output")
+    ok = ok and hist[0] == 0 and hist[13] > 0 and sum(hist[14:]) == 0
+
+    d, hist, path = grci.Module("Shift4").depth()
+    ok = ok and d.register_depth == 6 and path[-1] == "Bit#0.Dff#1" and path[1].startswith("Bit#0.Mux#0")
+
+    named = grci.Module("NamedBit")
+    d, hist, _ = named.depth()
+    part, part_hist, _ = named.depth("bit")
+    ok = ok and part.depth == d.depth and part_hist == hist and sum(hist) > 0 and named.depth("missing") == None
+    report("depth", ok)
+
+    grci.quit()
+
+
+def test_partition(hdl_path):
+    grci.init()
+    with open(hdl_path, "r") as f:
+        grci.compile_src(f.read())
+
+    #every Bit of a Shift4 passes a dff output on, so the parts step exactly like the whole module
+    ref = grci.Module("Shift4")
+    split = [grci.Partition("Shift4", 0), grci.Partition("Shift4", 2)]
+    ok = not grci.Partition("Missing").partition and not grci.Partition("Nand").partition
+    for i in range(40):
+        ref.inp = [(i * 5) % 7 < 3, i % 3 != 0]
+        ref.step()
+        for p in split:
+            p.inp = list(ref.inp)
+            ok = ok and p.step() and p.out == ref.out
+    for p in split:
+        p.destroy()
+
+    #the Not part of an And reads the Nand part's output straight from a gate, which would arrive a step late
+    ok = ok and not grci.Partition("And", 0).partition and not grci.Partition("And", 2).partition
+    report("partition", ok)
+
+    grci.quit()
+
+
+def test_limits(hdl_path):
+    grci.init()
+    with open(hdl_path, "r") as f:
+        grci.compile_src(f.read())
+
+    e = grci.estimate("Shift4")
+    ok = e != None and e.dff_count == 4 and e.ram_count == 0 and e.node_count > 4 and e.bytes > 0
+    ok = ok and grci.estimate("Missing") == None and not grci.lib.grci_init_module(grci.g, b"Missing", 7)
+
+    grci.set_limits(max_nodes=e.node_count - 1)
+    ok = ok and not grci.lib.grci_init_module(grci.g, b"Shift4", 6)
+    grci.set_limits(max_bytes=e.bytes - 1)
+    ok = ok and not grci.lib.grci_init_module(grci.g, b"Shift4", 6)
+
+    #once the cap is reached the module stays where it was
+    grci.set_limits(max_nodes=e.node_count, max_bytes=e.bytes, max_cycles=3)
+    limited = grci.Module("Shift4")
+    grci.set_limits()
+    ref = grci.Module("Shift4")
+    trace = []
+    for i in range(8):
+        for m in [limited, ref]:
+            m.inp = [i == 0, True]
+            m.step_cycle()
+        trace.append(list(ref.out))
+        ok = ok and limited.out == trace[min(i, 2)]
+    ok = ok and trace[2] != trace[-1]
+    report("limits", ok)
+
+    grci.quit()
+
+
+def word_bits(word):
+    return [(word >> i) & 1 == 1 for i in range(16)]
+
+def test_ram_image():
+    grci.init()
+    grci.compile_src("module Memory(in[16], load, addr[16]) -> out[16] { ram: Ram64K(in, load, addr) -> out }")
+
+    #a word read at a is bytes a and a + 1, low byte first
+    m = grci.Module("Memory")
+    ok = m.ram_load("ram", 0x100, bytes([0x34, 0x12, 0x78, 0x56]))
+    m.inp = word_bits(0) + [False] + word_bits(0x102)
+    m.step_cycle()
+    ok = ok and m.out == word_bits(0x5678)
+    m.inp = word_bits(0xbeef) + [True] + word_bits(0x100)
+    m.step_cycle()
+    ok = ok and m.ram_dump("ram", 0x100, 4) == bytes([0xef, 0xbe, 0x78, 0x56])
+
+    ok = ok and m.ram_dump_file("ram", 0x100, 4, "ram.bin") and m.ram_load_file("ram", 0xfffc, "ram.bin")
+    ok = ok and m.ram_dump("ram", 0xfffc, 4) == bytes([0xef, 0xbe, 0x78, 0x56])
+
+    #nothing may reach past the end of the ram, and a failed load leaves it as it was
+    ok = ok and m.ram_dump("ram", 0x10000, 0) == b"" and m.ram_dump("ram", 0x10000, 1) == None
+    ok = ok and m.ram_dump("ram", 0xffff, 2) == None and not m.ram_dump_file("ram", 0xffff, 2, "ram.bin")
+    ok = ok and not m.ram_load("ram", 0xffff, bytes([1, 2])) and not m.ram_load("ram", 0x10001, b"")
+    ok = ok and not m.ram_load_file("ram", 0xfffd, "ram.bin") and not m.ram_load_file("ram", 0, "missing.bin")
+    ok = ok and m.ram_dump("ram", 0xfffc, 4) == bytes([0xef, 0xbe, 0x78, 0x56])
+    ok = ok and not m.ram_load("missing", 0, b"") and m.ram_dump("missing", 0, 1) == None
+    report("ram images", ok)
+
+    grci.quit()
+
+
+def test_ram_share():
+    grci.init()
+    grci.compile_src("module Memory(in[16], load, addr[16]) -> out[16] { ram: Ram64K(in, load, addr) -> out }")
+
+    image = bytes(range(1, 9))
+    a = grci.Module("Memory")
+    b = grci.Module("Memory")
+    ok = a.ram_load("ram", 0x100, image) and b.ram_share("ram", a, "ram") and b.ram_dump("ram", 0x100, 8) == image
+
+    #a page written by one instance is copied first, so the other keeps reading the shared image
+    a.inp = word_bits(0xbeef) + [True] + word_bits(0x100)
+    a.step_cycle()
+    ok = ok and a.ram_dump("ram", 0x100, 2) == bytes([0xef, 0xbe]) and b.ram_dump("ram", 0x100, 8) == image
+    b.inp = word_bits(0) + [False] + word_bits(0x104)
+    b.step_cycle()
+    ok = ok and b.out == word_bits(0x0605)
+    ok = ok and b.ram_load("ram", 0x102, bytes([0xaa])) and a.ram_dump("ram", 0x102, 1) == bytes([3])
+
+    #pages nobody wrote are the shared zero page, which a write must not change for anyone else
+    b.inp = word_bits(0x1234) + [True] + word_bits(0x4000)
+    b.step_cycle()
+    c = grci.Module("Memory")
+    ok = ok and b.ram_dump("ram", 0x4000, 2) == bytes([0x34, 0x12])
+    ok = ok and a.ram_dump("ram", 0x4000, 2) == bytes(2) and c.ram_dump("ram", 0x4000, 2) == bytes(2)
+    ok = ok and not a.ram_share("missing", b, "ram")
+    report("shared ram pages", ok)
+
+    grci.quit()
+
+
+#a ram next to a shift register, so that both ram pages and dffs have to come back
+machine_src = "module Machine(in[16], load, addr[16], s) -> out[16], q[4] { ram: Ram64K(in, load, addr) -> out  Shift4(s, 1) -> q }"
+
+def machine_inputs(i):
+    return word_bits((i * 2654435761) & 0xffff) + [i % 3 == 0] + word_bits((i * 7) % 64) + [i % 5 < 2]
+
+#steps a new Machine through the first count inputs
+def machine_replay(count):
+    m = grci.Module("Machine")
+    for i in range(count):
+        m.inp = machine_inputs(i)
+        m.step()
+    return m
+
+def test_checkpoints(hdl_path):
+    grci.init()
+    with open(hdl_path, "r") as f:
+        grci.compile_src(f.read() + machine_src)
+
+    m = grci.Module("Machine")
+    ok = m.set_checkpoints(16, 1 << 20)
+    for i in range(200):
+        m.inp = machine_inputs(i)
+        m.step()
+    for step in [77, 64, 3]:
+        ref = machine_replay(step)
+        ok = ok and m.seek(step) and m.step_count() == step and m.out == ref.out
+        ok = ok and m.ram_dump("ram", 0, 128) == ref.ram_dump("ram", 0, 128)
+    ok = ok and not m.seek(4)
+
+    #a small budget drops the oldest steps, and what is left still replays exactly
+    m = grci.Module("Machine")
+    ok = ok and m.set_checkpoints(16, 32768)
+    for i in range(3000):
+        m.inp = machine_inputs(i)
+        m.step()
+    ref = machine_replay(2900)
+    ok = ok and not m.seek(0) and not m.seek(1000) and m.seek(2900) and m.out == ref.out
+    ok = ok and m.ram_dump("ram", 0, 128) == ref.ram_dump("ram", 0, 128)
+    ok = ok and not grci.Module("Machine").seek(0)
+    report("checkpoints", ok)
+
+    grci.quit()
+
+
+def test_journal(hdl_path):
+    grci.init()
+    with open(hdl_path, "r") as f:
+        grci.compile_src(f.read() + machine_src)
+
+    #each step back must land on exactly what was there after the step before
+    ok = True
+    for max_bytes, steps in [(1 << 20, 50), (256, 50)]:
+        m = grci.Module("Machine")
+        ok = ok and m.set_journal(max_bytes)
+        seen = [(list(m.out), m.ram_dump("ram", 0, 128))]
+        for i in range(steps):
+            m.inp = machine_inputs(i)
+            m.step()
+            seen.append((list(m.out), m.ram_dump("ram", 0, 128)))
+        back = 0
+        while m.step_back():
+            back += 1
+            ok = ok and m.step_count() == steps - back and (m.out, m.ram_dump("ram", 0, 128)) == seen[steps - back]
+        #the large journal holds every step, the small one only the newest few
+        ok = ok and (back == steps if max_bytes > 256 else 0 < back < steps)
+        ok = ok and m.step_count() == steps - back
+    ok = ok and not grci.Module("Machine").step_back() and not grci.Module("Machine").set_journal(4)
+    report("journal", ok)
+
+    grci.quit()
+
+
+def test_netlist(hdl_path):
+    grci.init()
+    with open(hdl_path, "r") as f:
+        grci.compile_src(f.read() + "module Latch(s, r) -> q { Nand(s, nb) -> a  Nand(r, a) -> nb  a -> q }")
+
+    #the interpreter steps a latch, but a netlist with a gate loop is refused on import
+    path = "netlist.grcn".encode("utf-8")
+    ok = True
+    for name, imports in [("Shift4", True), ("Latch", False)]:
+        m = grci.Module(name)
+        ok = ok and grci.lib.grci_export_netlist(m.module, path)
+        imported = grci.lib.grci_import_netlist(grci.g, path)
+        ok = ok and bool(imported) == imports
+        if imported:
+            grci.lib.grci_destroy_module(imported)
+    report("netlist import", ok)
 
     grci.quit()
 
 
 test_file(builtin_modules.tests, None)
 test_file(basic.tests, "test.hdl")
+test_file(builtin_modules.tests, None, "netlist.grcn")
+test_file(basic.tests, "test.hdl", "netlist.grcn")
+test_file(basic.tests, "test.hdl", None, grci.ORDER_RCM)
+test_file(basic.tests, "test.hdl", "netlist.grcn", grci.ORDER_LEVEL)
+test_file(builtin_modules.tests, None, None, None, grci.ENGINE_COMPILED)
+test_file(basic.tests, "test.hdl", "netlist.grcn", grci.ORDER_RCM, grci.ENGINE_COMPILED)
+test_file(basic.tests, "test.hdl", None, None, None, True)
+test_file(builtin_modules.tests, None, None, None, grci.ENGINE_COMPILED, True)
+test_file(basic.tests, "test.hdl", None, grci.ORDER_LANES, grci.ENGINE_COMPILED)
+test_file(basic.tests, "test.hdl", None, None, grci.ENGINE_EVENT)
+test_file(builtin_modules.tests, None, None, None, grci.ENGINE_EVENT, True)
+test_file(basic.tests, "test.hdl", None, grci.ORDER_LANES, grci.ENGINE_LEVELIZED)
+test_file(basic.tests, "test.hdl", None, None, grci.ENGINE_TIMING)
+test_file(builtin_modules.tests, None, None, None, grci.ENGINE_TIMING)
+test_truth_tables(basic.tests, "test.hdl")
+test_equivalence("test.hdl")
+test_capture("test.hdl")
+test_cycles("test.hdl")
+test_reset("test.hdl")
+test_pool("test.hdl")
+test_links("test.hdl")
+test_activity()
+test_foreign()
+test_engines("test.hdl")
+test_limits("test.hdl")
+test_timing("test.hdl")
+test_depth("test.hdl")
+test_partition("test.hdl")
+test_netlist("test.hdl")
+test_ram_image()
+test_ram_share()
+test_checkpoints("test.hdl")
+test_journal("test.hdl")
 
 
 print(str(passed) + "/" + str(total))
-